@@ -5,13 +5,37 @@
 class Component {
     public:
         Component(){};
+        virtual ~Component(){};
 		void add_output(Propagatable* port){
 			output_ports.push_back( port );
 		}
+        const vector<Propagatable*>& get_output_ports() {
+            return output_ports;
+        }
         virtual void tick() = 0;
         virtual void post_tick() {
 			for (auto port:output_ports) port->propagate();
 		}
+        // Quiescence interface used by Circuit::fast_forward.
+        // idle_ticks() returns how many upcoming ticks skip_ticks() can reproduce exactly without ticking,
+        // given the current input values. 0 (the default) means the component has to be ticked.
+        virtual unsigned long long idle_ticks() {
+            return 0;
+        }
+        virtual void skip_ticks(unsigned long long n) {};
+        // Checkpoint interface used by Circuit::save_state, between two ticks.
+        // save_state() writes the values of the output ports and everything else tick() depends on besides the wiring,
+        // load_state() reads them back into a component built and wired the same way.
+        // Components with more state override both and call the base versions first.
+        virtual void save_state(StateWriter& out) {
+            for (auto port:output_ports) port->save_value(out);
+        }
+        virtual void load_state(StateReader& in) {
+            for (auto port:output_ports) port->load_value(in);
+        }
+#ifdef DTCQ_PROFILE
+        int profile_type = -1; // counters of the component type in the TickProfiler of the circuit
+#endif
 	protected:
 		vector<Propagatable*> output_ports;
 };
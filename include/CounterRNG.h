@@ -0,0 +1,80 @@
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+#include<stdint.h>
+#include<limits>
+#include<array>
+using namespace std;
+
+// independent substreams of the same seed, one per use of random numbers in the simulation
+enum RNGStream : uint64_t {
+    RNG_STREAM_TRIGGER = 1,         // L1 trigger tosses
+    RNG_STREAM_EVENT_SAMPLING = 2,  // which input event is played for a trigger
+    RNG_STREAM_ASSIGNMENT = 3,      // random chip to event builder assignment
+    RNG_STREAM_SPLITTING = 4,       // seeds of the trajectories cloned by multilevel splitting
+};
+
+// Counter-based generator (Philox4x32-10): the n-th number of a stream is a pure function of (seed, stream, n),
+// so streams don't share any state, can be reproduced separately and can be started at any position.
+// Satisfies UniformRandomBitGenerator, so it can be used with the <random> distributions and std::shuffle.
+class CounterRNG {
+    public:
+        using result_type = uint64_t;
+
+        CounterRNG(uint64_t _seed, uint64_t _stream, uint64_t _position=0) : seed(_seed), stream(_stream) {
+            seek(_position);
+        }
+        static constexpr result_type min() {return 0;}
+        static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        result_type operator()() {
+            if (position%2==0) block = philox({uint32_t(position/2), uint32_t((position/2)>>32), uint32_t(stream), uint32_t(stream>>32)});
+            uint64_t ret = (uint64_t(block[(position%2)*2+1])<<32) | block[(position%2)*2];
+            position++;
+            return ret;
+        }
+        // uniform integer in [0, n), without modulo bias (Lemire's multiply and reject)
+        uint64_t uniform(uint64_t n) {
+            __uint128_t m = (__uint128_t)(*this)() * n;
+            uint64_t low = uint64_t(m);
+            if (low < n) {
+                uint64_t threshold = (0-n) % n;
+                while (low < threshold) {
+                    m = (__uint128_t)(*this)() * n;
+                    low = uint64_t(m);
+                }
+            }
+            return uint64_t(m>>64);
+        }
+        // uniform double in [0, 1) with 53 random bits
+        double uniform_real() {
+            return ((*this)()>>11) * 0x1.0p-53;
+        }
+        // number of 64-bit values drawn so far, with the seed enough to resume the stream later
+        uint64_t get_position() {return position;}
+        uint64_t get_seed() {return seed;}
+        void seek(uint64_t _position) {
+            position = _position;
+            if (position%2==1) block = philox({uint32_t(position/2), uint32_t((position/2)>>32), uint32_t(stream), uint32_t(stream>>32)});
+        }
+    private:
+        std::array<uint32_t,4> philox(std::array<uint32_t,4> counter) {
+            uint32_t key0 = uint32_t(seed);
+            uint32_t key1 = uint32_t(seed>>32);
+            for (int iround=0; iround<10; iround++) {
+                uint64_t product0 = uint64_t(0xD2511F53u) * counter[0];
+                uint64_t product1 = uint64_t(0xCD9E8D57u) * counter[2];
+                counter = {uint32_t(product1>>32) ^ counter[1] ^ key0, uint32_t(product1), uint32_t(product0>>32) ^ counter[3] ^ key1, uint32_t(product0)};
+                key0 += 0x9E3779B9u;
+                key1 += 0xBB67AE85u;
+            }
+            return counter;
+        }
+
+        uint64_t seed;
+        uint64_t stream;
+        uint64_t position = 0;
+        std::array<uint32_t,4> block {0,0,0,0};
+};
+
+#endif /* COUNTERRNG_H */
@@ -0,0 +1,55 @@
+#ifndef EVENTCHIPMATRIX_H
+#define EVENTCHIPMATRIX_H
+#include<stdint.h>
+#include<stdlib.h>
+#include<memory>
+#include<new>
+#include<algorithm>
+#include<assert.h>
+using namespace std;
+
+// Stream size and parsing time of every chip in every input event, in one contiguous allocation.
+// Size and parsing time of a chip are interleaved, since they are read together when the chip starts an event.
+// Each event row starts on a 64-byte cache line.
+class EventChipMatrix {
+    public:
+        struct Entry {
+            unsigned short size;
+            unsigned short parse_time;
+        };
+        static const int alignment = 64;
+
+        EventChipMatrix(int _nevents, int _nchips) : nevents(_nevents), nchips(_nchips) {
+            assert(nevents>0 && nchips>0);
+            const int entries_per_line = alignment / sizeof(Entry);
+            row_stride = (nchips + entries_per_line - 1) / entries_per_line * entries_per_line;
+            Entry* allocated = static_cast<Entry*>(aligned_alloc(alignment, get_bytes()));
+            if (!allocated) throw std::bad_alloc();
+            entries.reset(allocated, free);
+            std::fill(entries.get(), entries.get() + size_t(nevents) * row_stride, Entry{0, 0});
+        }
+        // view of entries laid out by another matrix (e.g. a memory-mapped cache file), kept alive by _entries
+        EventChipMatrix(int _nevents, int _nchips, int _row_stride, std::shared_ptr<Entry> _entries) :
+            nevents(_nevents), nchips(_nchips), row_stride(_row_stride), entries(_entries) {
+            assert(nevents>0 && nchips>0 && row_stride>=nchips);
+            assert(reinterpret_cast<uintptr_t>(entries.get()) % alignment == 0);
+        }
+        // the player keeps a pointer to the matrix, so it is neither copied nor moved
+        EventChipMatrix(const EventChipMatrix&) = delete;
+        EventChipMatrix& operator=(const EventChipMatrix&) = delete;
+
+        int get_nevents() const {return nevents;}
+        int get_nchips() const {return nchips;}
+        int get_row_stride() const {return row_stride;}
+        const Entry* row(int ievent) const {return entries.get() + size_t(ievent) * row_stride;}
+        Entry* row(int ievent) {return entries.get() + size_t(ievent) * row_stride;}
+        const Entry& at(int ievent, int ichip) const {return row(ievent)[ichip];}
+        Entry& at(int ievent, int ichip) {return row(ievent)[ichip];}
+        size_t get_bytes() const {return size_t(nevents) * row_stride * sizeof(Entry);}
+    private:
+        int nevents;
+        int nchips;
+        int row_stride; // entries per event row, padded to whole cache lines
+        std::shared_ptr<Entry> entries;
+};
+#endif /* EVENTCHIPMATRIX_H */
@@ -3,6 +3,7 @@
 #include<include/Component.h>
 #include<include/Ports.h>
 #include<queue>
+#include<limits>
 using namespace std;
 template<typename T>
 class FIFO : public Component {
@@ -21,6 +22,12 @@ class FIFO : public Component {
 			add_output(&out_empty);
 		}
 
+        template<typename F> void for_each_output(F f) {
+            f(out_data);
+            f(out_data_valid);
+            f(out_empty);
+        }
+
         queue<T> buffer;
         void tick() {
             out_data_valid.set_value(false);
@@ -35,6 +42,19 @@ class FIFO : public Component {
             }
 
             out_empty.set_value(buffer.size()==0);
+        }
+        // an empty FIFO without push does nothing, whatever in_pop_enable does
+        unsigned long long idle_ticks() override {
+            if (in_push_enable.get_value() or out_data_valid.get_value() or buffer.size()>0) return 0;
+            return std::numeric_limits<unsigned long long>::max();
+        }
+        void save_state(StateWriter& out) override {
+            Component::save_state(out);
+            out.write(buffer);
+        }
+        void load_state(StateReader& in) override {
+            Component::load_state(in);
+            in.read(buffer);
         }
 		int d_get_buffer_size(){
 			return buffer.size();
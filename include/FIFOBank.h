@@ -0,0 +1,215 @@
+#ifndef FIFOBANK_H
+#define FIFOBANK_H
+#include<include/Component.h>
+#include<include/Ports.h>
+#include<vector>
+#include<memory>
+#include<limits>
+#include<stdint.h>
+#include<assert.h>
+using namespace std;
+
+// A bank of FIFOs that behave exactly like FIFO<T>, stored as structure of arrays:
+// one contiguous ring buffer per lane in a single allocation, contiguous head / occupancy arrays,
+// contiguous arrays of the input values (push / pop enable, data) that the input ports of the lanes are bound to,
+// and of the output values (data, valid, empty).
+// The tick works on these arrays: the pop decisions and the empty flags with the maximum occupancy are branch-free passes over
+// all lanes, only the ring buffer moves are done per lane, for the lanes that push or pop. The output ports are then set
+// for the lanes whose outputs changed. On a signal plane the inputs read the plane, the enables are gathered into the arrays first.
+// Rings start with a fixed capacity and are all doubled in the rare case one of them is full.
+template<typename T>
+class FIFOBank : public Component {
+    public:
+        // the ports of one FIFO of the bank, named as in FIFO so that wiring code works with either
+        class Lane {
+            public:
+                InputPort<T> in_data;
+                InputPort<bool> in_push_enable;
+                InputPort<bool> in_pop_enable;
+
+                OutputPort<T> out_data;
+                OutputPort<bool> out_data_valid;
+                OutputPort<bool> out_empty;
+
+                int d_get_buffer_size(){
+                    return bank->occupancy[index];
+                }
+            private:
+                friend class FIFOBank<T>;
+                FIFOBank<T>* bank = nullptr;
+                int index = 0;
+        };
+
+        FIFOBank(int _nlanes, int _capacity=1024) : Component(), nlanes(_nlanes), lanes(_nlanes), head(_nlanes, 0), occupancy(_nlanes, 0),
+            data_in(_nlanes, T(0)), data_out(_nlanes, T(0)),
+            push_enable(new bool[_nlanes]()), pop_enable(new bool[_nlanes]()), data_valid(new bool[_nlanes]()), empty(new bool[_nlanes]()) {
+            capacity = 1;
+            while (capacity < uint32_t(_capacity)) capacity <<= 1;
+            storage.assign(size_t(nlanes)*capacity, T(0));
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                lanes[ilane].bank = this;
+                lanes[ilane].index = ilane;
+                lanes[ilane].in_data.bind_storage(&data_in[ilane]);
+                lanes[ilane].in_push_enable.bind_storage(&push_enable[ilane]);
+                lanes[ilane].in_pop_enable.bind_storage(&pop_enable[ilane]);
+                empty[ilane] = true;
+                lanes[ilane].out_empty.set_value(true);
+                add_output(&(lanes[ilane].out_data));
+                add_output(&(lanes[ilane].out_data_valid));
+                add_output(&(lanes[ilane].out_empty));
+            }
+        }
+        // lanes are wired by address, the bank can't move
+        FIFOBank(const FIFOBank&) = delete;
+        FIFOBank& operator=(const FIFOBank&) = delete;
+
+        void tick() override {
+            if (nlanes==0) return;
+            // the lanes are wired alike, either all on a signal plane or none
+            bool on_plane = lanes[0].in_push_enable.is_aliased();
+            if (on_plane) gather_enables();
+            for (int ilane=0; ilane<nlanes; ilane++) data_valid[ilane] = pop_enable[ilane] & (occupancy[ilane]!=0);
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                bool pop = data_valid[ilane];
+                bool push = push_enable[ilane];
+                if (!(pop | push)) continue;
+                if (push && on_plane) data_in[ilane] = lanes[ilane].in_data.get_value();
+                changed_lanes.push_back(ilane);
+                if (pop) {
+                    data_out[ilane] = storage[size_t(ilane)*capacity + head[ilane]];
+                    head[ilane] = (head[ilane]+1) & (capacity-1);
+                    occupancy[ilane]--;
+                }
+                if (push) {
+                    if (occupancy[ilane] == capacity) grow();
+                    storage[size_t(ilane)*capacity + ((head[ilane]+occupancy[ilane]) & (capacity-1))] = data_in[ilane];
+                    occupancy[ilane]++;
+                }
+            }
+            uint32_t max_occupancy = 0;
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                empty[ilane] = occupancy[ilane]==0;
+                max_occupancy = std::max(max_occupancy, occupancy[ilane]);
+            }
+            last_max_occupancy = max_occupancy;
+            publish_outputs();
+        }
+
+        // same condition as FIFO, for all lanes
+        unsigned long long idle_ticks() override {
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                if (lanes[ilane].in_push_enable.get_value() || lanes[ilane].out_data_valid.get_value() || occupancy[ilane]>0) return 0;
+            }
+            return std::numeric_limits<unsigned long long>::max();
+        }
+
+        // only the words in the lanes are saved, the rings are restored starting at their first slot
+        void save_state(StateWriter& out) override {
+            Component::save_state(out);
+            out.write(capacity);
+            out.write(last_max_occupancy);
+            out.write(occupancy);
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                for (uint32_t iword=0; iword<occupancy[ilane]; iword++) out.write(storage[size_t(ilane)*capacity + ((head[ilane]+iword) & (capacity-1))]);
+            }
+        }
+        void load_state(StateReader& in) override {
+            Component::load_state(in);
+            in.read(capacity);
+            in.read(last_max_occupancy);
+            in.read(occupancy);
+            assert(occupancy.size()==nlanes);
+            storage.assign(size_t(nlanes)*capacity, T(0));
+            head.assign(nlanes, 0);
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                assert(occupancy[ilane]<=capacity);
+                for (uint32_t iword=0; iword<occupancy[ilane]; iword++) in.read(storage[size_t(ilane)*capacity + iword]);
+            }
+            // the output arrays follow the restored output ports, the valid flags drop on the next tick without a pop
+            popped_lanes.clear();
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                data_out[ilane] = lanes[ilane].out_data.get_value();
+                data_valid[ilane] = lanes[ilane].out_data_valid.get_value();
+                empty[ilane] = lanes[ilane].out_empty.get_value();
+                if (data_valid[ilane]) popped_lanes.push_back(ilane);
+            }
+        }
+
+        template<typename F> void for_each_output(F f) {
+            for (auto& lane : lanes) {
+                f(lane.out_data);
+                f(lane.out_data_valid);
+                f(lane.out_empty);
+            }
+        }
+
+        Lane* lane(int ilane) {
+            return &(lanes[ilane]);
+        }
+        int get_nlanes() {
+            return nlanes;
+        }
+        const uint32_t* get_occupancies() {
+            return occupancy.data();
+        }
+        // maximum occupancy among the lanes after the last tick
+        uint32_t get_max_occupancy() {
+            return last_max_occupancy;
+        }
+    private:
+        // the inputs aliased to a signal plane read it, not the arrays; the data is only read by the lanes that push
+        void gather_enables() {
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                push_enable[ilane] = lanes[ilane].in_push_enable.get_value();
+                pop_enable[ilane] = lanes[ilane].in_pop_enable.get_value();
+            }
+        }
+        // The output ports keep their values until set again: only the lanes that pushed or popped change,
+        // and those that popped on the tick before drop their valid flag.
+        void publish_outputs() {
+            for (int ilane : popped_lanes) {
+                if (!data_valid[ilane]) lanes[ilane].out_data_valid.set_value(false);
+            }
+            popped_lanes.clear();
+            for (int ilane : changed_lanes) {
+                if (data_valid[ilane]) {
+                    lanes[ilane].out_data.set_value(data_out[ilane]);
+                    popped_lanes.push_back(ilane);
+                }
+                lanes[ilane].out_data_valid.set_value(data_valid[ilane]);
+                lanes[ilane].out_empty.set_value(empty[ilane]);
+            }
+            changed_lanes.clear();
+        }
+        void grow() {
+            vector<T> new_storage(storage.size()*2, T(0));
+            for (int ilane=0; ilane<nlanes; ilane++) {
+                for (uint32_t iword=0; iword<occupancy[ilane]; iword++) {
+                    new_storage[size_t(ilane)*capacity*2 + iword] = storage[size_t(ilane)*capacity + ((head[ilane]+iword) & (capacity-1))];
+                }
+                head[ilane] = 0;
+            }
+            storage.swap(new_storage);
+            capacity *= 2;
+        }
+
+        const int nlanes;
+        uint32_t capacity;
+        vector<Lane> lanes;
+        vector<T> storage;
+        vector<uint32_t> head;
+        vector<uint32_t> occupancy;
+        // values of the lane ports
+        vector<T> data_in;
+        vector<T> data_out;
+        std::unique_ptr<bool[]> push_enable;
+        std::unique_ptr<bool[]> pop_enable;
+        std::unique_ptr<bool[]> data_valid;
+        std::unique_ptr<bool[]> empty;
+        // lanes that pushed or popped on this tick, and that popped on the tick before
+        vector<int> changed_lanes;
+        vector<int> popped_lanes;
+        uint32_t last_max_occupancy = 0;
+};
+
+#endif /* FIFOBANK_H */
@@ -2,11 +2,27 @@
 #define PORTS_H
 
 #include<vector>
+#include<type_traits>
+#include<include/SignalPlane.h>
+#include<include/StateStream.h>
 using namespace std;
 
 class Propagatable {
     public:
         virtual void propagate() = 0;
+        // moving the wire onto a signal plane: reserve a slot first, bind after the plane is allocated
+        virtual void reserve_slot(SignalPlane& plane) = 0;
+        virtual void bind_slot(SignalPlane& plane) = 0;
+        // number of connected inputs
+        virtual size_t get_fanout() = 0;
+        // value of the wire in a checkpoint, restored into the connected inputs as well
+        virtual void save_value(StateWriter& out) = 0;
+        virtual void load_value(StateReader& in) = 0;
+#ifdef DTCQ_PROFILE
+        // calls to update(), and those that had a changed value to copy into the inputs
+        unsigned long long profile_propagations = 0;
+        unsigned long long profile_changes = 0;
+#endif
 };
 
 template<typename T>
@@ -22,8 +38,46 @@ class Port {
     protected:
         T value=0;
 };
+// Reads the value of its driver on the signal plane when bound to one, otherwise its own value.
+// A bound input always shows the driver's value of the previous tick, so set_value() on it has no lasting effect.
+// The own value can be kept in an element of a component's array instead (bind_storage), e.g. so that a FIFOBank
+// reads the inputs of all its lanes as contiguous arrays.
 template<typename T>
 class InputPort: public Port<T> {
+    public:
+        InputPort(){};
+        // a copy holds its own value, it doesn't share the storage of the original
+        InputPort(const InputPort& other) : Port<T>(other), source(other.source), source_bit(other.source_bit) {
+            Port<T>::value = *other.storage;
+        }
+        InputPort& operator=(const InputPort& other) {
+            *storage = *other.storage;
+            source = other.source;
+            source_bit = other.source_bit;
+            return *this;
+        }
+        T get_value(){
+            if (source==nullptr) return *storage;
+            if constexpr (std::is_same<T,bool>::value) return (*source>>source_bit) & 1ull;
+            else return T(*source);
+        };
+        void set_value(T new_value) {
+            *storage = new_value;
+        }
+        // keep the own value in *external from now on, starting with the current one
+        void bind_storage(T* external) {
+            *external = *storage;
+            storage = external;
+        }
+        void alias(const uint64_t* _source, int _source_bit) {
+            source = _source;
+            source_bit = _source_bit;
+        }
+        bool is_aliased() {return source!=nullptr;}
+    protected:
+        T* storage = &(Port<T>::value);
+        const uint64_t* source = nullptr;
+        int source_bit = 0;
 };
 
 
@@ -36,7 +90,61 @@ class OutputPort: public Port<T>, public Propagatable {
             connected_ports.push_back(other);
         }
 
+        void set_value(T new_value) {
+            Port<T>::value = new_value;
+            if (slot==nullptr) return;
+            if constexpr (std::is_same<T,bool>::value) *slot = (*slot & ~(1ull<<slot_bit)) | (uint64_t(new_value)<<slot_bit);
+            else *slot = uint64_t(new_value);
+        }
+
+        virtual void reserve_slot(SignalPlane& plane) override {
+            if constexpr (std::is_same<T,bool>::value) slot_index = plane.reserve_bit();
+            else slot_index = plane.reserve_word();
+        }
+        // the connected inputs read the slot of the current buffer directly, nothing left to propagate
+        virtual void bind_slot(SignalPlane& plane) override {
+            const uint64_t* source;
+            if constexpr (std::is_same<T,bool>::value) {
+                slot = plane.next_bit_word(slot_index);
+                slot_bit = slot_index%64;
+                source = plane.current_bit_word(slot_index);
+            }
+            else {
+                slot = plane.next_word(slot_index);
+                source = plane.current_word(slot_index);
+            }
+            set_value(Port<T>::value);
+            for(auto port: connected_ports) {
+                port->alias(source, slot_bit);
+            }
+        }
+
+        virtual size_t get_fanout() override {
+            return connected_ports.size();
+        }
+
+        virtual void save_value(StateWriter& out) override {
+            out.write(Port<T>::value);
+        }
+        // the inputs see the value as after a propagation, or as after the next swap of the signal plane
+        virtual void load_value(StateReader& in) override {
+            T new_value = in.read<T>();
+            set_value(new_value);
+            last_value = new_value;
+            for(auto port: connected_ports) {
+                port->set_value(new_value);
+            }
+        }
+
         virtual void propagate() override{
+            update();
+        }
+        // non-virtual propagate, for engines that know the port type at compile time
+        inline void update() {
+#ifdef DTCQ_PROFILE
+            profile_propagations++;
+            if (Port<T>::value != last_value) profile_changes++;
+#endif
             if (Port<T>::value == last_value) return;
             for(auto port: connected_ports) {
                 port->set_value(Port<T>::value);
@@ -46,6 +154,9 @@ class OutputPort: public Port<T>, public Propagatable {
     protected:
         vector<InputPort<T>*> connected_ports;
         T last_value=0;
+        int slot_index = -1;
+        uint64_t* slot = nullptr;
+        int slot_bit = 0;
 };
 
 
@@ -0,0 +1,69 @@
+#ifndef SIGNALPLANE_H
+#define SIGNALPLANE_H
+
+#include<vector>
+#include<algorithm>
+#include<stdint.h>
+#include<assert.h>
+using namespace std;
+
+// Storage for all wires of a circuit in two contiguous arrays, one bit per bool wire and one word per other wire.
+// Output ports write their slot in the "next" buffer during the tick, input ports read the driving slot of
+// the "current" buffer directly, and swap() publishes the whole tick at once, replacing the per-port propagate.
+// Slots are reserved first, then allocate() fixes the addresses that the ports keep pointers to.
+class SignalPlane {
+    public:
+        SignalPlane(){};
+        int reserve_bit() {
+            return nbits++;
+        }
+        int reserve_word() {
+            return nwords++;
+        }
+        // called between components, so that components ticked on different threads never write the same word
+        void align_bits() {
+            nbits = (nbits+63)/64*64;
+        }
+        void allocate() {
+            align_bits();
+            current_bits.assign(nbits/64, 0);
+            next_bits.assign(nbits/64, 0);
+            current_words.assign(nwords, 0);
+            next_words.assign(nwords, 0);
+            allocated = true;
+        }
+        bool is_allocated() {
+            return allocated;
+        }
+        uint64_t* next_bit_word(int slot) {
+            assert(allocated);
+            return &(next_bits[slot/64]);
+        }
+        const uint64_t* current_bit_word(int slot) {
+            assert(allocated);
+            return &(current_bits[slot/64]);
+        }
+        uint64_t* next_word(int slot) {
+            assert(allocated);
+            return &(next_words[slot]);
+        }
+        const uint64_t* current_word(int slot) {
+            assert(allocated);
+            return &(current_words[slot]);
+        }
+        // output ports keep their value until written again, so "next" is copied rather than exchanged
+        void swap() {
+            std::copy(next_bits.begin(), next_bits.end(), current_bits.begin());
+            std::copy(next_words.begin(), next_words.end(), current_words.begin());
+        }
+    private:
+        int nbits = 0;
+        int nwords = 0;
+        bool allocated = false;
+        vector<uint64_t> current_bits;
+        vector<uint64_t> next_bits;
+        vector<uint64_t> current_words;
+        vector<uint64_t> next_words;
+};
+
+#endif /* SIGNALPLANE_H */
@@ -0,0 +1,111 @@
+#ifndef STATESTREAM_H
+#define STATESTREAM_H
+#include<stdint.h>
+#include<string>
+#include<vector>
+#include<deque>
+#include<queue>
+#include<ostream>
+#include<istream>
+#include<stdexcept>
+#include<type_traits>
+#include<algorithm>
+using namespace std;
+
+// Binary state of the simulation for checkpoints, in native byte order without padding or field names:
+// the reader has to be built the same way as the writer (same components, sizes and wiring) and read the
+// values back in the order they were written. Containers are prefixed with their number of elements.
+class StateWriter {
+    public:
+        StateWriter(std::ostream& _os) : os(_os) {};
+        template<typename T> void write(const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain values are written as bytes");
+            os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        template<typename T> void write(const std::vector<T>& values) {
+            write<uint64_t>(values.size());
+            if constexpr (std::is_same<T,bool>::value) {
+                for (bool value : values) write<uint8_t>(value);
+            }
+            else {
+                static_assert(std::is_trivially_copyable<T>::value, "only vectors of plain values are written as bytes");
+                os.write(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(T));
+            }
+        }
+        template<typename T> void write(const std::deque<T>& values) {
+            write<uint64_t>(values.size());
+            for (const T& value : values) write(value);
+        }
+        // queue has no iterators, it is copied
+        template<typename T> void write(std::queue<T> values) {
+            write<uint64_t>(values.size());
+            for (; !values.empty(); values.pop()) write(values.front());
+        }
+        // mostly zero counts (histograms): the size, then the index and value of the non-zero ones
+        void write_sparse(const std::vector<unsigned long long>& values) {
+            write<uint64_t>(values.size());
+            write<uint64_t>(values.size() - std::count(values.begin(), values.end(), 0ull));
+            for (size_t i=0; i<values.size(); i++) {
+                if (values[i]==0) continue;
+                write<uint64_t>(i);
+                write(values[i]);
+            }
+        }
+        void write(const std::string& value) {
+            write<uint64_t>(value.size());
+            os.write(value.data(), value.size());
+        }
+        bool good() {return os.good();}
+    private:
+        std::ostream& os;
+};
+
+// Throws std::runtime_error if the stream ends before the value
+class StateReader {
+    public:
+        StateReader(std::istream& _is) : is(_is) {};
+        template<typename T> void read(T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain values are read as bytes");
+            read_bytes(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+        template<typename T> T read() {
+            T value;
+            read(value);
+            return value;
+        }
+        template<typename T> void read(std::vector<T>& values) {
+            values.resize(read<uint64_t>());
+            if constexpr (std::is_same<T,bool>::value) {
+                for (size_t i=0; i<values.size(); i++) values[i] = read<uint8_t>();
+            }
+            else {
+                read_bytes(reinterpret_cast<char*>(values.data()), values.size()*sizeof(T));
+            }
+        }
+        template<typename T> void read(std::deque<T>& values) {
+            values.resize(read<uint64_t>());
+            for (T& value : values) read(value);
+        }
+        template<typename T> void read(std::queue<T>& values) {
+            values = std::queue<T>();
+            for (uint64_t n=read<uint64_t>(); n>0; n--) values.push(read<T>());
+        }
+        void read_sparse(std::vector<unsigned long long>& values) {
+            values.assign(read<uint64_t>(), 0);
+            for (uint64_t n=read<uint64_t>(); n>0; n--) {
+                uint64_t i = read<uint64_t>();
+                if (i>=values.size()) throw std::runtime_error("checkpoint has a count out of its histogram");
+                read(values[i]);
+            }
+        }
+        void read(std::string& value) {
+            value.resize(read<uint64_t>());
+            read_bytes(&value[0], value.size());
+        }
+    private:
+        void read_bytes(char* bytes, size_t n) {
+            if (n>0 && !is.read(bytes, n)) throw std::runtime_error("checkpoint ends before the state is complete");
+        }
+        std::istream& is;
+};
+#endif /* STATESTREAM_H */
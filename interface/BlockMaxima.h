@@ -0,0 +1,63 @@
+#ifndef BLOCKMAXIMA_H
+#define BLOCKMAXIMA_H
+#include <interface/OccupancyHistogram.h>
+#include <stdint.h>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <assert.h>
+using namespace std;
+
+// Maxima of several series (e.g. FIFO occupancies) over consecutive blocks of base_period ticks,
+// and at the same time over blocks of base_period*2^k ticks for each level k<nlevels.
+// The maxima of a level are the pairwise maxima of the level below, so each closed block costs O(nlevels) per series.
+// The distribution of the block maxima of each level and series is kept as a histogram.
+class BlockMaximaLadder {
+    public:
+        BlockMaximaLadder(int _nseries, unsigned long long _base_period, int _nlevels) :
+            nseries(_nseries), base_period(_base_period), nlevels(_nlevels),
+            partial_maxima(size_t(_nseries)*_nlevels, 0), histograms(size_t(_nseries)*_nlevels) {
+            assert(base_period>0 && nlevels>0 && nlevels<64);
+        };
+        // n ticks during which the series have these values
+        void record(const uint32_t* values, unsigned long long n) {
+            while (n>0) {
+                unsigned long long ticks = std::min(n, base_period - ticks_in_block);
+                uint32_t* block_maxima = partial_maxima.data();
+                for (int iseries=0; iseries<nseries; iseries++, block_maxima+=nlevels) {
+                    block_maxima[0] = std::max(block_maxima[0], values[iseries]);
+                }
+                ticks_in_block += ticks;
+                n -= ticks;
+                if (ticks_in_block==base_period) close_block();
+            }
+        }
+        int get_nlevels() const {return nlevels;}
+        unsigned long long get_period(int ilevel) const {return base_period<<ilevel;}
+        const OccupancyHistogram& get_histogram(int iseries, int ilevel) const {return histograms[size_t(iseries)*nlevels + ilevel];}
+        // block maxima distributions of a series per level, as a JSON object
+        void write_json(std::ostream& os, int iseries) const;
+        void save_state(StateWriter& out) const {
+            out.write(ticks_in_block);
+            out.write(closed_blocks);
+            out.write(partial_maxima);
+            for (const OccupancyHistogram& histogram : histograms) histogram.save_state(out);
+        }
+        void load_state(StateReader& in) {
+            in.read(ticks_in_block);
+            in.read(closed_blocks);
+            in.read(partial_maxima);
+            assert(partial_maxima.size()==size_t(nseries)*nlevels);
+            for (OccupancyHistogram& histogram : histograms) histogram.load_state(in);
+        }
+    private:
+        void close_block();
+        int nseries;
+        unsigned long long base_period;
+        int nlevels;
+        unsigned long long ticks_in_block = 0;
+        unsigned long long closed_blocks = 0; // of the base period
+        std::vector<uint32_t> partial_maxima; // series-major, maximum of the running block of each level
+        std::vector<OccupancyHistogram> histograms; // series-major
+};
+#endif /* BLOCKMAXIMA_H */
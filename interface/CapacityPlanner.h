@@ -0,0 +1,52 @@
+#ifndef CAPACITYPLANNER_H
+#define CAPACITYPLANNER_H
+#include <include/EventChipMatrix.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+using namespace std;
+
+// Analytic estimate of the load of a configuration, in milliseconds instead of a full simulation.
+// Triggers are taken as a Poisson process at the mean rate of the data player (bunch pattern included, trigger rule not),
+// the input events are sampled uniformly from the event-chip matrix as the player does.
+//  - an e-link is a queue of the chip's events, serving one 64-bit word every ticks_per_word ticks,
+//    the bits of consecutive events are packed, so an event takes size/64 words,
+//  - a boundary finder serves the words of an event, duplicated so that each event starts a word, i.e. max(1, size/64),
+//    one per tick and halts for the parsing time of the event when parsing,
+//  - the output link of an event builder is a queue of whole events, serving one of these words per tick.
+// All are M/G/1 queues: the mean wait is Pollaczek-Khinchine's, the tail is taken exponential, P(W>t) = rho*exp(-rho*t/E[W]).
+// The wait of the output link in ticks is the backlog in front of an event in words. It includes the event on the link,
+// already out of the FIFOs, so it is an upper estimate of the output FIFO occupancy of the event builder.
+class CapacityPlanner {
+    public:
+        struct Queue {
+            double words_per_event = 0;
+            double utilization = 0; // above 1 the queue grows without bound, the waits are infinite
+            double mean_wait = 0; // ticks
+            double p99_wait = 0;
+            double p9999_wait = 0;
+        };
+        CapacityPlanner(std::shared_ptr<const EventChipMatrix> events, const std::vector<int>& ticks_per_word, const std::vector<int>& eb_assignment, int neb, double ticks_per_trigger, bool do_parse);
+
+        const Queue& get_elink(int ichip) const {return elinks[ichip];}
+        const Queue& get_boundary_finder(int ichip) const {return boundary_finders[ichip];}
+        const Queue& get_builder(int ieb) const {return builders[ieb];}
+        int get_overloaded_chips() const;
+        int get_overloaded_builders() const;
+        // loads and tail estimates per event builder and per chip, as a JSON object
+        void write_json(std::ostream& os, const std::vector<std::string>& chip_names) const;
+    private:
+        // service time moments of one event in ticks
+        static Queue make_queue(double words_per_event, double mean_service, double mean_square_service, double ticks_per_trigger);
+        static double wait_quantile(const Queue& queue, double q);
+        static void write_queue_json(std::ostream& os, const Queue& queue);
+
+        double ticks_per_trigger;
+        std::vector<int> eb_assignment;
+        std::vector<Queue> elinks;
+        std::vector<Queue> boundary_finders;
+        std::vector<Queue> builders;
+};
+#endif /* CAPACITYPLANNER_H */
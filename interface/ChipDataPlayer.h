@@ -1,5 +1,11 @@
+#ifndef CHIPDATAPLAYER_H
+#define CHIPDATAPLAYER_H
 #include <include/Component.h>
 #include <include/Ports.h>
+#include <include/CounterRNG.h>
+#include <include/EventChipMatrix.h>
+#include <interface/EventChunkStream.h>
+#include <interface/TriggerSchedule.h>
 #include <deque>
 #include <algorithm>
 #include <iostream>
@@ -19,35 +25,97 @@ public:
     std::vector<OutputPort<bool>> out_read;
     std::vector<OutputPort<uint64_t>> out_data;
 
-    ChipDataPlayer(int _nchips, vector<vector<unsigned short>> _vec_event_chip_sizes, vector<vector<unsigned short>> _vec_event_chip_parse_time, vector<float> elink_chip_ratio, int _NE=1, bool is_random_l1=true, bool use_trigger_rule=true);
+    ChipDataPlayer(int _nchips, std::shared_ptr<const EventChipMatrix> _event_chip_matrix, vector<float> elink_chip_ratio, int _NE=1, bool is_random_l1=true, bool use_trigger_rule=true, uint64_t seed=233);
+    // play the input of a stream: the events are sampled within the current chunk, which is replaced by the next one
+    // after as many triggers as it has events, and released once all chips have sent its events
+    ChipDataPlayer(int _nchips, std::shared_ptr<EventChunkStream> _event_stream, vector<float> elink_chip_ratio, int _NE=1, bool is_random_l1=true, bool use_trigger_rule=true, uint64_t seed=233);
 
     void tick() override;
+    bool is_random_l1() {return RANDOM_L1;}
+    // tick with the trigger mode fixed at compile time, tick() dispatches to it
+    template<bool RANDOM_TRIGGER> void tick_impl();
+    template<typename F> void for_each_output(F f) {
+        for (auto& port : out_read) f(port);
+        for (auto& port : out_data) f(port);
+    }
+    // up to the last trigger issued, so that potential - blocked = issued
+    unsigned long long get_potential_trigger_counts() {return potential_trigger_counts;}
+    unsigned long long get_blocked_trigger_counts() {return blocked_trigger_counts;}
+    unsigned long long get_triggered_events() {return triggered_events;}
+    // words sent by a chip, at most one per ticks_per_word ticks on its e-links
+    unsigned long long get_words_sent(int ichip) {return words_sent[ichip];}
+    int get_ticks_per_word(int ichip) {return ticks_per_word[ichip];}
+    // chips that sent a word on the last tick, the word is on their out_data
+    const std::vector<int>& get_chips_sent() {return chips_sent_last_tick;}
+    // mean ticks between triggers before the trigger rule: one in bunches_per_trigger non-empty bunch crossings (10 ticks each) triggers
+    double get_mean_ticks_per_trigger() {
+        return 10.0*(ticks_per_event/10)*bunches_per_orbit/std::count(bunch_not_empty, bunch_not_empty+bunches_per_orbit, true);
+    }
+    // input events played, the current chunk when streaming
+    std::shared_ptr<const EventChipMatrix> get_event_chip_matrix() {return event_chip_matrix;}
+    unsigned long long idle_ticks() override;
+    void skip_ticks(unsigned long long n) override;
+    // the triggered events are saved as rows of the input matrix, so a player of a streamed input can't be saved
+    void save_state(StateWriter& out) override;
+    void load_state(StateReader& in) override;
+    // draw the triggers and input events from the streams of another seed from now on,
+    // the next trigger is already drawn and stays as it is
+    void reseed(uint64_t seed);
 private:
+    void schedule_next_trigger();
+    // timing wheel of the e-link slots: chips with the same ticks_per_word send on the same ticks,
+    // so a group of them is scheduled at its next slot as long as one of its chips has words to send
+    struct ElinkGroup {
+        int ticks_per_word;
+        std::vector<int> pending_chips; // chips of the group with bits or an empty event queued
+        bool scheduled = false;
+    };
+    void add_pending_chip(int ichip);
+    void schedule_group(int igroup, unsigned long long tick);
+    void emit_word(int ichip);
+    bool has_queued_word(int ichip) {return queued_empty_event[ichip] || chip_trigger_cursor[ichip]<triggered_events;}
+    void push_trigger(const EventChipMatrix::Entry* event_row);
+    void release_trigger(unsigned long long itrigger);
+    // row of the input matrix, -1 for none
+    int64_t row_index(const EventChipMatrix::Entry* row) {return row ? (row - event_chip_matrix->row(0)) / event_chip_matrix->get_row_stride() : -1;}
+    const EventChipMatrix::Entry* row_at(int64_t index) {return index>=0 ? event_chip_matrix->row(index) : nullptr;}
     const bool RANDOM_L1;
     const bool TRIGGER_RULE;
+    std::unique_ptr<TriggerSchedule> trigger_schedule;
+    CounterRNG event_rng; // input event played for each trigger
     unsigned long long nticks = 0;
     int max_event_idx;
-    int triggered_events;
+    unsigned long long triggered_events = 0;
     int nchips;
     int NE;
-    int nbunch = 0; // cyclic counting bunch from 0-3563;
-    std::vector<std::vector<unsigned short>> vec_event_chip_sizes;
-    std::vector<std::vector<unsigned short>> vec_event_chip_parse_time;
-    uint64_t value;
+    unsigned long long next_trigger_tick = 0; // the accepted triggers are generated ahead of the clock
+    TriggerSchedule::Trigger next_trigger;
+    unsigned long long potential_trigger_counts = 0;
+    unsigned long long blocked_trigger_counts = 0;
+    const EventChipMatrix::Entry* next_trigger_event_row = nullptr;
+    std::shared_ptr<const EventChipMatrix> event_chip_matrix; // input events (the current chunk when streaming), shared with the loader and read only
+    std::shared_ptr<EventChunkStream> event_stream;
+    int triggers_from_chunk = 0;
+    std::deque<std::pair<unsigned long long, std::shared_ptr<const EventChipMatrix>>> retired_chunks; // with the first trigger not using them
     static const int ticks_per_word_per_elink = 20; // assuming all chip has rate of 1.28Gbps, 400M * 64 / 1.28G = 20
     std::vector<int> ticks_per_word; //ticks_per_word_per_elink divided by e-link-to-chip ratio
     static const int trigger_rate =  750; // in kHz
     int ticks_per_event =  400*1000/trigger_rate; // 533, but to be modified in constructor to account for bunch structure
-    static const int bunches_per_orbit = 3564;
+    static constexpr int bunches_per_orbit = 3564;
     bool bunch_not_empty[bunches_per_orbit] = {0}; //modified in initializer
-    static const int trigger_rule_max_L1As = 8;
-    static const int trigger_rule_bunch_period = 130; // No more than 8 L1As within 130 bunch crossings;
-    std::deque<int> time_since_recent_L1As;
-    std::vector<std::deque<unsigned short>> remaining_bits_for_triggered_events;
-    std::vector<std::deque<unsigned short>> queued_chip_parse_time;
+    // triggered events shared by all chips: ring of input event rows, the n-th trigger at n modulo the ring size
+    std::vector<const EventChipMatrix::Entry*> triggered_event_ring;
+    std::vector<int> triggered_event_chips_left; // chips that haven't sent the whole event yet
+    unsigned long long first_kept_trigger = 0; // triggers before it are sent by all chips
+    std::vector<unsigned long long> chip_trigger_cursor; // trigger each chip is sending
+    std::vector<unsigned short> chip_remaining_bits; // remaining bits of that trigger, once started
     std::vector<bool> new_event_flag;
     std::vector<bool> queued_empty_event;
-
-    int potential_trigger_counts = 0;
-    int blocked_trigger_counts = 0;
+    std::vector<ElinkGroup> elink_groups;
+    std::vector<int> chip_elink_group;
+    std::vector<bool> chip_pending;
+    std::vector<std::vector<int>> emission_wheel; // groups due on each tick, indexed by tick modulo the wheel size
+    std::vector<int> chips_sent_last_tick; // their outputs go back to 0 unless they send again
+    std::vector<unsigned long long> words_sent;
 };
+#endif /* CHIPDATAPLAYER_H */
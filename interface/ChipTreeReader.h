@@ -0,0 +1,38 @@
+#ifndef CHIPTREEREADER_H
+#define CHIPTREEREADER_H
+#include <include/EventChipMatrix.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <type_traits>
+using namespace std;
+
+// Identification of a chip tree of the input, as written to ordered_chips.csv
+struct ChipInfo {
+    int32_t tree_module; // module number in the tree name
+    int32_t dtc;
+    int32_t barrel;
+    int32_t layer;
+    int32_t disk;
+    int32_t module_id;
+    int32_t chip;
+    // chip basename used by the config files
+    std::string basename() const;
+};
+static_assert(std::is_trivially_copyable<ChipInfo>::value, "ChipInfo is stored as raw bytes in the event size cache");
+
+// The chips of one DTC and their stream sizes and parsing times in every input event
+struct DTCInput {
+    std::vector<ChipInfo> chips;
+    std::shared_ptr<EventChipMatrix> event_chip_matrix;
+};
+
+// read the chip trees of the DTC directory dtcname in a chiptrees.root file, on up to nthreads threads
+DTCInput read_dtc_from_root(std::string root_file_name, std::string dtcname, int nthreads=1);
+// read the chip trees of the DTC directory dtcname in chunks of events, see EventChunkStream
+class EventChunkSource;
+std::shared_ptr<EventChunkSource> open_dtc_stream_from_root(std::string root_file_name, std::string dtcname);
+// names of the DTC directories in a chiptrees.root file
+std::vector<std::string> list_dtcs_in_root(std::string root_file_name);
+#endif /* CHIPTREEREADER_H */
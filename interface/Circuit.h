@@ -1,19 +1,50 @@
 #ifndef CIRCUIT_H
 #define CIRCUIT_H
 #include<include/Component.h>
+#include<include/SignalPlane.h>
+#include<include/StateStream.h>
+#include<interface/TickProfiler.h>
 #include<vector>
 #include<memory>
+#include<limits>
 
 using namespace std;
 class Circuit {
     public:
         Circuit(){};
-        void tick();
+        virtual ~Circuit(){};
+        virtual void tick();
+        // skip the ticks over which every component is idle, returns the number of ticks skipped (possibly 0)
+        unsigned long long fast_forward(unsigned long long max_ticks=std::numeric_limits<unsigned long long>::max());
 
-        void add_component(std::shared_ptr<Component> component) {
+        // Move all wires onto a SignalPlane, post_tick() is then replaced by a single swap of the plane.
+        // To be called once, after all components are added and connected.
+        void use_signal_plane();
+        bool has_signal_plane() {return signal_plane!=nullptr;}
+        // Checkpoint of all components between two ticks, in the order they were added.
+        // The circuit restored has to be built and wired the same way, its engine (threads, static, signal plane) may differ.
+        void save_state(StateWriter& out);
+        void load_state(StateReader& in);
+        virtual int get_nthreads() {return 1;}
+
+        // Sample the cycles and allocations of each component type on every sample_period-th tick, see TickProfiler.
+        // Only effective when compiled with DTCQ_PROFILE.
+        void enable_profiling(int sample_period);
+        TickProfiler* get_profiler() {return profiler.get();}
+
+        // partition groups components that only talk to each other (e.g. all chips of one event builder),
+        // it is ignored by the serial engine and used by ParallelCircuit to keep sub-circuits on the same thread
+        void add_component(std::shared_ptr<Component> component, int partition=-1) {
             components.push_back(component);
+            component_partitions.push_back(partition);
         }
     protected:
         vector<std::shared_ptr<Component>> components;
+        vector<int> component_partitions;
+        std::unique_ptr<SignalPlane> signal_plane;
+        // the profiler if the tick about to run is sampled, otherwise nullptr
+        TickProfiler* start_profiled_tick();
+        std::unique_ptr<TickProfiler> profiler;
+        int signal_plane_section = -1;
 };
 #endif /* CIRCUIT_H */
@@ -0,0 +1,72 @@
+#ifndef CONVERGENCEMONITOR_H
+#define CONVERGENCEMONITOR_H
+#include <include/StateStream.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <ostream>
+using namespace std;
+
+// Batch means of statistics of a run (e.g. the p99.9 occupancy of each chip over consecutive batches of ticks),
+// to stop the run once all of them are known precisely enough.
+// For independent batches, the mean of a statistic over n batches has a Student-t 95% confidence interval of half width t(n-1)*s/sqrt(n).
+// Batches too short to be independent have positively correlated means, which makes that interval too narrow: the half width is
+// widened by sqrt((1+r)/(1-r)), the ratio for batch means following an AR(1) process of lag-1 autocorrelation r, with r the
+// estimated lag-1 autocorrelation when positive. A statistic has converged when its half width is at most precision times its mean,
+// the mean being taken at least min_scale so that statistics that stay near 0 (an idle chip) converge as well.
+class ConvergenceMonitor {
+    public:
+        ConvergenceMonitor(const std::vector<std::string>& _names, double _precision, int _min_batches=10, double _min_scale=1) :
+            names(_names), precision(_precision), min_batches(_min_batches), min_scale(_min_scale), means(_names.size(), 0), square_deviations(_names.size(), 0),
+            first_values(_names.size(), 0), last_values(_names.size(), 0), lag_products(_names.size(), 0) {};
+        // the value of each statistic over the last batch
+        void add_batch(const std::vector<double>& values);
+        int get_nbatches() const {return nbatches;}
+        double get_mean(int iseries) const {return means[iseries];}
+        // lag-1 autocorrelation of the batch values, 0 for fewer than 3 batches or a constant statistic
+        double get_lag1_autocorrelation(int iseries) const;
+        // |r| beyond it is significant at the 5% level for independent batches
+        double get_autocorrelation_bound() const;
+        // half width of the 95% confidence interval, widened for a positive lag-1 autocorrelation
+        double get_half_width(int iseries) const;
+        double get_relative_half_width(int iseries) const;
+        // the statistic with the largest relative half width
+        int get_worst_series() const;
+        const std::string& get_name(int iseries) const {return names[iseries];}
+        bool converged() const;
+        // mean and confidence interval of each statistic, as a JSON object
+        void write_json(std::ostream& os) const;
+        void save_state(StateWriter& out) const {
+            out.write(nbatches);
+            out.write(means);
+            out.write(square_deviations);
+            out.write(first_values);
+            out.write(last_values);
+            out.write(lag_products);
+        }
+        void load_state(StateReader& in) {
+            in.read(nbatches);
+            in.read(means);
+            in.read(square_deviations);
+            in.read(first_values);
+            in.read(last_values);
+            in.read(lag_products);
+            if (means.size()!=names.size() || square_deviations.size()!=names.size() || lag_products.size()!=names.size()) throw std::runtime_error("checkpoint of a convergence monitor with other statistics");
+        }
+        // 0.975 quantile of Student's t distribution with dof degrees of freedom
+        static double student_t_975(int dof);
+    private:
+        std::vector<std::string> names;
+        double precision;
+        int min_batches;
+        double min_scale;
+        int nbatches = 0;
+        // Welford's running mean and sum of squared deviations
+        std::vector<double> means;
+        std::vector<double> square_deviations;
+        // for the lag-1 autocovariance: the first and last batch values, and the sum of the products of consecutive ones
+        std::vector<double> first_values;
+        std::vector<double> last_values;
+        std::vector<double> lag_products;
+};
+#endif /* CONVERGENCEMONITOR_H */
@@ -1,3 +1,5 @@
+#ifndef DTCEVENTBUILDER_H
+#define DTCEVENTBUILDER_H
 #include <include/Component.h>
 #include <include/Ports.h>
 #include <algorithm>
@@ -7,6 +9,7 @@
 #include <numeric>
 #include <assert.h>
 #include <stdexcept>
+#include <limits>
 
 using namespace std;
 // only read data from the next event after all data from this event is processed
@@ -23,7 +26,21 @@ public:
     OutputPort<bool> out_event_ready ;
     DTCEventBuilder(int _nchips, int output_links);
     void tick() override ;
+    unsigned long long idle_ticks() override;
+    void skip_ticks(unsigned long long n) override;
+    void save_state(StateWriter& out) override;
+    void load_state(StateReader& in) override;
     int get_ID();
+    // run counters, in clock ticks
+    unsigned long long get_events_built() {return events_built;}
+    unsigned long long get_link_busy_ticks() {return link_busy_ticks;} // output links sending an event
+    unsigned long long get_wait_ticks() {return wait_ticks;} // some chips have the full event, waiting for the slowest ones
+    unsigned long long get_link_blocked_ticks() {return link_blocked_ticks;} // next event complete, waiting for the output links
+    template<typename F> void for_each_output(F f) {
+        for (auto& port : out_read_data) f(port);
+        for (auto& port : out_read_control) f(port);
+        f(out_event_ready);
+    }
 private:
     int nchips;
     const int OUTPUT_LINKS;
@@ -38,4 +55,9 @@ private:
     bool processing_new_event = true;
     int WORD_PER_CLOCK_TICK_TO_SEND_EVENT = 0; // equals to number of output links with 25GB/s speed. By design this can be up to 16.
     int remaining_time_to_send_last_event = 0;
+    unsigned long long events_built = 0;
+    unsigned long long link_busy_ticks = 0;
+    unsigned long long wait_ticks = 0;
+    unsigned long long link_blocked_ticks = 0;
 };
+#endif /* DTCEVENTBUILDER_H */
@@ -24,8 +24,24 @@ class EventBoundaryFinder : public Component {
 
         EventBoundaryFinder(bool _do_parse=false);
 		void tick() override;
+        // tick with do_parse fixed at compile time, tick() dispatches to it
+        template<bool DO_PARSE> void tick_impl();
+        template<typename F> void for_each_output(F f) {
+            f(out_fifo_i1_pop);
+            f(out_fifo_o1_read);
+            f(out_fifo_o1_data);
+            f(out_fifo_o2_read);
+            f(out_fifo_o2_data);
+        }
+        unsigned long long idle_ticks() override;
+        void skip_ticks(unsigned long long n) override;
+        void save_state(StateWriter& out) override;
+        void load_state(StateReader& in) override;
+        // ticks spent halted for parsing
+        unsigned long long get_halt_ticks() {return halt_ticks;}
     private:
         uint32_t halt_time = 0;
+        unsigned long long halt_ticks = 0;
         queue<uint64_t> queued_data_words;
         queue<uint16_t> queued_control_words;
 
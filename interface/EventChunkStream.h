@@ -0,0 +1,35 @@
+#ifndef EVENTCHUNKSTREAM_H
+#define EVENTCHUNKSTREAM_H
+#include <include/EventChipMatrix.h>
+#include <interface/ChipTreeReader.h>
+#include <memory>
+#include <future>
+#include <vector>
+using namespace std;
+
+// An input that can be read in ranges of events, for inputs too large to be held in memory at once
+class EventChunkSource {
+    public:
+        virtual ~EventChunkSource() {};
+        virtual int get_nevents() = 0;
+        virtual const std::vector<ChipInfo>& get_chips() = 0;
+        // events [first_event, first_event+nevents) of all chips
+        virtual std::shared_ptr<EventChipMatrix> read_chunk(int first_event, int nevents) = 0;
+};
+
+// Reads the events of a source in consecutive chunks of chunk_events, starting over at the end of the input.
+// The chunk after the one returned by next_chunk() is read ahead on a separate thread.
+class EventChunkStream {
+    public:
+        EventChunkStream(std::shared_ptr<EventChunkSource> _source, int _chunk_events);
+        ~EventChunkStream();
+        std::shared_ptr<const EventChipMatrix> next_chunk();
+        int get_nchips() {return source->get_chips().size();}
+    private:
+        void prefetch();
+        std::shared_ptr<EventChunkSource> source;
+        int chunk_events;
+        int next_first_event = 0;
+        std::future<std::shared_ptr<EventChipMatrix>> prefetched_chunk;
+};
+#endif /* EVENTCHUNKSTREAM_H */
@@ -0,0 +1,124 @@
+#ifndef EVENTLEVELENGINE_H
+#define EVENTLEVELENGINE_H
+#include <interface/ChipDataPlayer.h>
+#include <interface/OccupancyHistogram.h>
+#include <interface/OccupancyContainer.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <memory>
+using namespace std;
+
+// The ChipDataPlayer -> input FIFO -> EventBoundaryFinder -> output FIFOs -> DTCEventBuilder pipeline of dtc,
+// simulated from one word or event to the next instead of tick by tick, for sweeps over many configurations.
+// The words of the player are followed by state machines that reproduce the clocked components (one tick from an
+// output to the inputs it drives) but jump over the ticks on which nothing changes:
+//  - the input FIFO and boundary finder of a chip only depend on the words of that chip,
+//  - on the event builder side a chip runs on its own until it holds its full event and has read all its words,
+//    the chips of an event builder only meet when it completes the event, once all of them are there and the output
+//    link has sent the previous one.
+// The simulation advances in windows of ticks. The occupancy changes of a window are turned into the same histograms
+// as the tick engine fills: per chip (lanes), per event builder (sum of its lanes) and for the whole DTC.
+class EventLevelEngine {
+    public:
+        static const int window_ticks = 1<<16;
+        // accepted differences with the tick engine in the cross-validation: distance between the occupancy
+        // distributions (largest difference of their cumulative distributions) and relative difference of the run length
+        static constexpr double occupancy_tolerance = 0.01;
+        static constexpr double nticks_tolerance = 0.001;
+
+        // the player is built from the same input, seed and options as the one of the circuit, output_links as in DTCEventBuilder
+        EventLevelEngine(std::shared_ptr<ChipDataPlayer> _player, const std::vector<int>& eb_assignment, int _neb, bool _do_parse, int _output_links=1);
+        // run until every event builder has built nevents events, as the tick loop of dtc, returns the number of ticks
+        unsigned long long run(int nevents);
+
+        // histograms of the FIFO occupancy after each tick, with the lanes of an event builder in the order of its chips
+        const std::vector<LaneOccupancyHistograms>& get_histograms(OccupancyFIFO ififo) const {return histograms[ififo];}
+        const OccupancyHistogram& get_total_histogram(OccupancyFIFO ififo) const {return total_histograms[ififo];}
+        unsigned long long get_events_built(int ieb) const {return builders[ieb].events_built;}
+    private:
+        // occupancy changes of one FIFO not in the histograms yet, pushes and pops each in tick order
+        struct LaneChanges {
+            std::vector<unsigned long long> pushes;
+            std::vector<unsigned long long> pops;
+            uint32_t occupancy = 0;
+            unsigned long long last_tick = 0; // ticks before are in the histogram
+        };
+        struct OutputWord {
+            unsigned long long push_tick;
+            bool header; // leading bit of the control word
+        };
+        // a chip with its FIFOs, its boundary finder and its side of the event builder, port values as set on the last tick
+        struct Chip {
+            int eb;
+            int index_in_eb;
+            // input FIFO: words of the player with the tick they are pushed on, the first n_arrived ones are in the FIFO
+            std::deque<std::pair<unsigned long long, uint64_t>> input;
+            size_t n_arrived = 0;
+            // EventBoundaryFinder
+            unsigned long long tick = 0; // next tick of the input FIFO and boundary finder
+            bool pop = false;
+            bool in_valid = false;
+            uint64_t in_data = 0;
+            uint32_t halt_time = 0;
+            int queued_words = 0;
+            // output data and control FIFOs get the same words on the same ticks and are read separately,
+            // counted from the start of the run, output holds the words from output_base on
+            std::deque<OutputWord> output;
+            unsigned long long output_base = 0;
+            unsigned long long data_popped = 0;
+            unsigned long long control_popped = 0;
+            // DTCEventBuilder
+            unsigned long long eb_tick = 0; // next tick of the output FIFOs and event builder
+            bool read_data = false;
+            bool read_control = false;
+            bool data_valid = false;
+            bool control_valid = false;
+            bool control_header = false;
+            int words_to_read = 0;
+            int buffer_counter = 0;
+            bool full_event = false;
+            bool new_event_header = false;
+            // full event and all its words read, nothing changes until the event builder completes the event
+            bool settled = false;
+            unsigned long long settled_tick = 0;
+            LaneChanges changes[OCCUPANCY_NFIFOS];
+        };
+        struct Builder {
+            std::vector<int> chips;
+            unsigned long long earliest_completion = 0; // once the output link has sent the last event
+            unsigned long long events_built = 0;
+            unsigned long long last_event_tick = 0; // of the nevents-th event
+            std::vector<unsigned long long> window_completions; // ticks of the events built in the current window
+        };
+        // sum of the occupancies of several lanes (an event builder or the DTC) and the tick it last changed on
+        struct SumSeries {
+            int32_t value = 0;
+            unsigned long long last_tick = 0;
+        };
+        void advance_player(unsigned long long end);
+        void advance_input(Chip& chip, unsigned long long end);
+        // returns whether the chip is settled
+        bool advance_output(Chip& chip, unsigned long long end);
+        void advance_builder(Builder& builder, unsigned long long end, int nevents);
+        void push_output(Chip& chip, unsigned long long tick, bool header);
+        // histograms of the ticks [window_start, end), all changes before end are known
+        void flush(unsigned long long window_start, unsigned long long end);
+        void flush_lane(LaneChanges& lane, int ififo, const Chip& chip, unsigned long long window_start, unsigned long long end);
+        void add_to_sum(int iseries, uint32_t value, unsigned long long n);
+
+        std::shared_ptr<ChipDataPlayer> player;
+        unsigned long long player_tick = 0;
+        int neb;
+        bool do_parse;
+        int output_links;
+        std::vector<Chip> chips;
+        std::vector<Builder> builders;
+        std::vector<LaneOccupancyHistograms> histograms[OCCUPANCY_NFIFOS];
+        OccupancyHistogram total_histograms[OCCUPANCY_NFIFOS];
+        // per FIFO the event builders then the DTC
+        std::vector<SumSeries> sum_series;
+        std::vector<int32_t> sum_deltas; // series-major, change of each series on each tick of the window
+        std::vector<uint64_t> sum_changed; // series-major, bit mask of the ticks of the window with a change
+};
+#endif /* EVENTLEVELENGINE_H */
@@ -0,0 +1,62 @@
+#ifndef EVENTSIZECACHE_H
+#define EVENTSIZECACHE_H
+#include <include/EventChipMatrix.h>
+#include <interface/ChipTreeReader.h>
+#include <interface/EventChunkStream.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+using namespace std;
+
+// Binary cache of the chip trees of a chiptrees.root file, read by memory-mapping it without any parsing.
+// Layout (native byte order, all offsets from the start of the file, sections aligned to 64 bytes):
+//   Header | DTCEntry x ndtcs | per DTC: ChipInfo x nchips, event-chip matrix rows as in EventChipMatrix
+// The matrices are used in place, a loaded DTCInput keeps the mapping alive.
+// The header records the size and modification time of the chiptrees.root it was converted from, to tell when it is stale.
+class EventSizeCache {
+    public:
+        static const uint32_t version = 2;
+        static constexpr char magic[8] = {'D','T','C','Q','E','V','S','Z'};
+
+        // map an existing cache file, throws if it is missing or has another version
+        EventSizeCache(std::string cache_file_name);
+        bool has_dtc(std::string dtcname);
+        // whether source_file_name differs in size or modification time from the file the cache was converted from
+        bool is_stale(std::string source_file_name);
+        DTCInput load(std::string dtcname);
+        // read the DTC in chunks of events, only the pages of the chunks in use stay resident
+        std::shared_ptr<EventChunkSource> open_stream(std::string dtcname);
+        // write the DTCs of source_file_name into a new cache file, reading them one at a time with read_dtc,
+        // source_file_name is empty for a synthetic input that has none
+        static void write(std::string cache_file_name, std::string source_file_name, const std::vector<std::string>& dtcnames, std::function<DTCInput(std::string)> read_dtc);
+    private:
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t ndtcs;
+            uint64_t file_bytes;
+            uint64_t source_bytes;
+            int64_t source_mtime_ns;
+            char padding[24];
+        };
+        struct DTCEntry {
+            char name[64];
+            uint32_t nchips;
+            uint32_t nevents;
+            uint32_t row_stride;
+            uint32_t padding0;
+            uint64_t chips_offset;
+            uint64_t matrix_offset;
+            char padding1[32];
+        };
+        static_assert(sizeof(Header)==64 && sizeof(DTCEntry)==128, "cache file layout changed");
+        const DTCEntry* find_dtc(std::string dtcname);
+        // size and modification time of a file, throws if it can't be read
+        static void stat_source(std::string source_file_name, uint64_t& bytes, int64_t& mtime_ns);
+
+        std::shared_ptr<char> mapping; // unmapped when the cache and all loaded matrices are gone
+        size_t mapping_bytes = 0;
+};
+#endif /* EVENTSIZECACHE_H */
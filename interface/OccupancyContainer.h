@@ -0,0 +1,136 @@
+#ifndef OCCUPANCYCONTAINER_H
+#define OCCUPANCYCONTAINER_H
+#include <interface/ChipTreeReader.h>
+#include <include/StateStream.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+using namespace std;
+
+// FIFOs of each chip stored in the occupancy container
+enum OccupancyFIFO {
+    OCCUPANCY_FIFO_INPUT = 0,
+    OCCUPANCY_FIFO_OUTPUT_DATA = 1,
+    OCCUPANCY_NFIFOS = 2,
+};
+
+// Single file with the occupancy of the FIFOs of every chip of a run, read by memory-mapping it
+// (here, or with numpy in plot/occupancy_container.py) without any decoding.
+// Layout (native byte order, all offsets from the start of the file, sections aligned to 64 bytes):
+//   Header | ChipRecord x nchips | chunk data | ChunkEntry x nchunks | ColumnEntry x nchunks x nfifos x nchips
+// A chunk covers a range of ticks. The column of a FIFO and chip in a chunk holds the changes of its occupancy:
+// uint32 tick offsets from the chunk start then uint16 values, the first change at offset 0, starting on 8 bytes.
+class OccupancyContainer {
+    public:
+        static const uint32_t version = 1;
+        static constexpr char magic[8] = {'D','T','C','Q','O','C','C','P'};
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t nchips;
+            uint32_t nfifos;
+            uint32_t neb;
+            uint64_t total_ticks;
+            uint64_t nchunks;
+            uint64_t chips_offset;
+            uint64_t chunks_offset;
+            uint64_t columns_offset;
+            uint64_t file_bytes;
+            char padding[56];
+        };
+        struct ChipRecord {
+            ChipInfo info;
+            int32_t eb;
+            int32_t index_in_eb; // lane of the chip in the FIFO banks of its event builder
+            char basename[64];
+            char padding[28];
+        };
+        struct ChunkEntry {
+            uint64_t first_tick;
+            uint64_t nticks;
+        };
+        struct ColumnEntry {
+            uint64_t offset;
+            uint32_t nchanges;
+            uint32_t reserved;
+        };
+        static_assert(sizeof(Header)==128 && sizeof(ChipRecord)==128 && sizeof(ChunkEntry)==16 && sizeof(ColumnEntry)==16, "occupancy container layout changed");
+
+        struct Column {
+            unsigned long long first_tick; // of the chunk
+            uint32_t nchanges;
+            const uint32_t* tick_offsets;
+            const uint16_t* values;
+        };
+        // map an existing container, throws if it is missing, truncated or has another version
+        OccupancyContainer(std::string file_name);
+        int get_nchips() const {return header->nchips;}
+        int get_neb() const {return header->neb;}
+        unsigned long long get_total_ticks() const {return header->total_ticks;}
+        unsigned long long get_nchunks() const {return header->nchunks;}
+        const ChipRecord& chip(int ichip) const {return chip_records[ichip];}
+        const ChunkEntry& chunk(unsigned long long ichunk) const {return chunk_entries[ichunk];}
+        Column column(unsigned long long ichunk, int ififo, int ichip) const;
+        // chunk that contains tick
+        unsigned long long find_chunk(unsigned long long tick) const;
+        // changes of the occupancy of a chip within [first_tick, last_tick), the first one at first_tick
+        void read(int ififo, int ichip, unsigned long long first_tick, unsigned long long last_tick,
+                std::vector<unsigned long long>& ticks, std::vector<uint16_t>& values) const;
+    private:
+        std::shared_ptr<char> mapping;
+        const Header* header;
+        const ChipRecord* chip_records;
+        const ChunkEntry* chunk_entries;
+        const ColumnEntry* column_entries;
+};
+
+// Writes an occupancy container from the occupancies of all FIFOs at each tick
+class OccupancyContainerWriter {
+    public:
+        // a chunk is closed once it has either many ticks or many changes buffered
+        static const uint32_t max_chunk_ticks = 1u<<24;
+        static const size_t max_chunk_changes = 1u<<22;
+        static const int stream_buffer_size = 1<<20; // bytes buffered before each write to the file
+
+        // resume keeps the file written so far by a run resumed from a checkpoint, load_state() then cuts it at the checkpoint
+        OccupancyContainerWriter(std::string file_name, const std::vector<ChipInfo>& chips, const std::vector<int>& eb_assignment, int neb, bool resume=false);
+        ~OccupancyContainerWriter();
+        OccupancyContainerWriter(const OccupancyContainerWriter&) = delete;
+        OccupancyContainerWriter& operator=(const OccupancyContainerWriter&) = delete;
+        bool good() {return bool(os);}
+        // one column per FIFO and chip
+        int get_ncolumns() {return ncolumns;}
+        static int column_index(int ififo, int ichip, int nchips) {return ififo*nchips + ichip;}
+        // n ticks with these occupancies, one per column
+        void record(const uint16_t* values, unsigned long long n);
+        // write the last chunk, the tables and the header
+        void close();
+        // the length of the file written so far, and the tables and the chunk being filled
+        void save_state(StateWriter& out);
+        // throws if the file is shorter than at the checkpoint
+        void load_state(StateReader& in);
+    private:
+        void flush_chunk();
+        template<typename T> void put(const T* x, size_t count) {os.write(reinterpret_cast<const char*>(x), sizeof(T)*count);}
+        void pad_to_multiple(uint64_t alignment);
+
+        std::string file_name;
+        std::vector<char> stream_buffer;
+        std::ofstream os;
+        bool closed = false;
+        OccupancyContainer::Header header;
+        int nchips;
+        int ncolumns;
+        unsigned long long total_ticks = 0;
+        std::vector<uint16_t> last_values;
+        // chunk being filled
+        uint32_t chunk_ticks = 0;
+        size_t chunk_changes = 0;
+        std::vector<std::vector<uint32_t>> column_tick_offsets;
+        std::vector<std::vector<uint16_t>> column_values;
+        std::vector<OccupancyContainer::ChunkEntry> chunks;
+        std::vector<OccupancyContainer::ColumnEntry> columns;
+};
+#endif /* OCCUPANCYCONTAINER_H */
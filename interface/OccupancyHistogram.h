@@ -0,0 +1,82 @@
+#ifndef OCCUPANCYHISTOGRAM_H
+#define OCCUPANCYHISTOGRAM_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <assert.h>
+#include <include/StateStream.h>
+using namespace std;
+
+// Number of ticks spent at each occupancy, the bins grow with the largest occupancy seen
+class OccupancyHistogram {
+    public:
+        void add(uint32_t value, unsigned long long n) {
+            if (value>=counts.size()) counts.resize(value+1, 0);
+            counts[value] += n;
+        }
+        const std::vector<unsigned long long>& get_counts() const {return counts;}
+        unsigned long long get_entries() const;
+        double get_mean() const;
+        // largest occupancy with any tick, the high-water mark
+        uint32_t get_max() const;
+        // smallest occupancy that at least a fraction q of the ticks don't exceed
+        uint32_t quantile(double q) const;
+        // largest difference between the cumulative distributions of this and another histogram (Kolmogorov-Smirnov)
+        double distance(const OccupancyHistogram& other) const;
+        // counts and summary statistics as a JSON object
+        void write_json(std::ostream& os) const;
+        void save_state(StateWriter& out) const {out.write_sparse(counts);}
+        void load_state(StateReader& in) {in.read_sparse(counts);}
+    private:
+        std::vector<unsigned long long> counts;
+};
+
+// Occupancy histograms of the lanes of a FIFOBank, stored lane-major in one array, and of their sum.
+// Filled from the contiguous occupancy array of the bank after each tick.
+class LaneOccupancyHistograms {
+    public:
+        LaneOccupancyHistograms(int _nlanes, uint32_t _nbins=64) : nlanes(_nlanes), nbins(_nbins), counts(size_t(_nlanes)*_nbins, 0) {};
+        // n ticks with these occupancies, max_occupancy is the largest of them; returns their sum
+        uint32_t record(const uint32_t* occupancies, uint32_t max_occupancy, unsigned long long n) {
+            if (max_occupancy>=nbins) grow(max_occupancy+1);
+            uint32_t sum = 0;
+            unsigned long long* lane_counts = counts.data();
+            for (int ilane=0; ilane<nlanes; ilane++, lane_counts+=nbins) {
+                lane_counts[occupancies[ilane]] += n;
+                sum += occupancies[ilane];
+            }
+            sum_histogram.add(sum, n);
+            return sum;
+        }
+        // n ticks of one lane, and of the sum, for producers that track the occupancies themselves
+        void add(int ilane, uint32_t value, unsigned long long n) {
+            if (value>=nbins) grow(value+1);
+            counts[size_t(ilane)*nbins + value] += n;
+        }
+        void add_sum(uint32_t value, unsigned long long n) {sum_histogram.add(value, n);}
+        OccupancyHistogram lane_histogram(int ilane) const;
+        // largest occupancy of any lane, the high-water mark of a single FIFO of the bank
+        uint32_t get_max_lane_occupancy() const;
+        // quantile of a lane over the ticks recorded since earlier, a copy of these histograms taken before
+        uint32_t lane_quantile_since(int ilane, double q, const LaneOccupancyHistograms& earlier) const;
+        const OccupancyHistogram& get_sum_histogram() const {return sum_histogram;}
+        void save_state(StateWriter& out) const {
+            out.write(nbins);
+            out.write_sparse(counts);
+            sum_histogram.save_state(out);
+        }
+        void load_state(StateReader& in) {
+            in.read(nbins);
+            in.read_sparse(counts);
+            assert(counts.size()==size_t(nlanes)*nbins);
+            sum_histogram.load_state(in);
+        }
+    private:
+        void grow(uint32_t min_nbins);
+        int nlanes;
+        uint32_t nbins;
+        std::vector<unsigned long long> counts;
+        OccupancyHistogram sum_histogram;
+};
+#endif /* OCCUPANCYHISTOGRAM_H */
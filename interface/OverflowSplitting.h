@@ -0,0 +1,75 @@
+#ifndef OVERFLOWSPLITTING_H
+#define OVERFLOWSPLITTING_H
+#include <interface/Circuit.h>
+#include <interface/ChipDataPlayer.h>
+#include <include/CounterRNG.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <ostream>
+using namespace std;
+
+// Rates at which an occupancy (e.g. the largest output FIFO occupancy of the DTC) reaches levels too rare for a direct run,
+// by fixed multilevel splitting along the main run.
+// An excursion starts when the occupancy is below the reset level (half the first level) and counts at the first level.
+// At each such crossing of the main run, the state of the circuit is cloned into factor trajectories, reseeded so that
+// their triggers and input events differ. Each runs until it reaches the next level, where it is cloned again, or falls back
+// below the reset level. The main run then continues from its own state, unchanged.
+// A trajectory at level k weighs 1/factor^k: the sum of the weights at level k over the crossings is an unbiased estimate of
+// the number of excursions of the main run reaching level k, divided by the main run length it is a rate.
+// The crossings are independent enough to take the error as the one of a compound Poisson sum, sqrt(sum of squared weights per crossing).
+class OverflowSplitting {
+    public:
+        struct Level {
+            uint32_t occupancy = 0;
+            unsigned long long trials = 0; // trajectories started at the level below
+            unsigned long long successes = 0; // of these, the ones that reached the level
+            double weights = 0; // sum over the crossings of the weights of the trajectories reaching the level
+            double square_weights = 0; // sum over the crossings of the squares of their weights
+        };
+        // levels ascending, the occupancy of the main run is given to observe() after each tick, the one of the trajectories is read with occupancy
+        OverflowSplitting(std::shared_ptr<Circuit> circuit, std::shared_ptr<ChipDataPlayer> player, std::function<uint32_t()> occupancy,
+                          const std::vector<uint32_t>& levels, int factor, uint64_t seed);
+
+        // the occupancy of the main run after a tick, splits at the first level
+        void observe(uint32_t occupancy) {
+            if (occupancy<reset_level) armed = true;
+            else if (armed && occupancy>=levels[0].occupancy) {
+                armed = false;
+                split_crossing();
+            }
+        }
+        const Level& get_level(int ilevel) const {return levels[ilevel];}
+        int get_nlevels() const {return levels.size();}
+        unsigned long long get_crossings() const {return levels[0].successes;}
+        unsigned long long get_truncated_trials() const {return truncated_trials;}
+        // excursions per tick reaching the level over a main run of nticks, and its 95% confidence interval
+        double get_rate(int ilevel, unsigned long long nticks) const;
+        double get_rate_error(int ilevel, unsigned long long nticks) const;
+        // rates per second and mean intervals between excursions at each level, as a JSON object
+        void write_json(std::ostream& os, unsigned long long nticks, double ticks_per_second) const;
+
+        // a trajectory that neither reaches the next level nor falls back within this many ticks counts as falling back
+        static const unsigned long long max_trial_ticks = 1ull<<26;
+    private:
+        void split_crossing();
+        // the trajectories from the state of a trajectory that just reached ilevel, of weight weight
+        void split(int ilevel, double weight);
+        bool run_trial(int ilevel);
+        std::string save();
+        void restore(const std::string& state);
+
+        std::shared_ptr<Circuit> circuit;
+        std::shared_ptr<ChipDataPlayer> player;
+        std::function<uint32_t()> occupancy;
+        std::vector<Level> levels;
+        uint32_t reset_level;
+        int factor;
+        bool armed = true;
+        CounterRNG seed_rng; // seeds of the trajectories
+        std::vector<double> crossing_weights; // per level, of the current crossing
+        unsigned long long truncated_trials = 0;
+};
+#endif /* OVERFLOWSPLITTING_H */
@@ -0,0 +1,49 @@
+#ifndef PARALLELCIRCUIT_H
+#define PARALLELCIRCUIT_H
+#include<interface/Circuit.h>
+#include<atomic>
+#include<thread>
+#include<vector>
+#include<memory>
+
+using namespace std;
+
+// Reusable barrier for a fixed number of threads, spins a while before yielding
+// since the phases between two waits are usually only a few microseconds long.
+class SpinBarrier {
+    public:
+        SpinBarrier(int _nthreads) : nthreads(_nthreads) {};
+        void wait();
+    private:
+        const int nthreads;
+        std::atomic<int> arrived {0};
+        std::atomic<unsigned> generation {0};
+};
+
+// Circuit ticked by a persistent pool of threads.
+// Within a phase components only read their own input ports and write their own output ports
+// (tick), or copy their own output ports into connected input ports (post_tick), so the result
+// is identical to the serial Circuit as long as every input port is driven by a single output port.
+// Components added to the same partition are always ticked by the same thread,
+// components without partition (-1) are spread over the least loaded threads.
+class ParallelCircuit : public Circuit {
+    public:
+        ParallelCircuit(int _nthreads);
+        ~ParallelCircuit();
+        void tick() override;
+        int get_nthreads() override {return nthreads;}
+    private:
+        void schedule();
+        void worker(int ithread);
+        void run_tick(int ithread);
+        void run_post_tick(int ithread);
+
+        const int nthreads;
+        size_t scheduled_components = 0;
+        vector<vector<Component*>> thread_components;
+        vector<std::thread> workers;
+        SpinBarrier barrier;
+        std::atomic<bool> stop {false};
+        TickProfiler* sampled = nullptr; // profiler of the running tick if sampled, set before the pool is released
+};
+#endif /* PARALLELCIRCUIT_H */
@@ -0,0 +1,109 @@
+#ifndef STATICCIRCUIT_H
+#define STATICCIRCUIT_H
+#include<interface/Circuit.h>
+#include<interface/ChipDataPlayer.h>
+#include<interface/EventBoundaryFinder.h>
+#include<tuple>
+#include<vector>
+#include<string>
+#include<typeinfo>
+#include<stdexcept>
+
+using namespace std;
+
+// How StaticCircuit ticks and propagates a component type without virtual calls.
+// The default calls the type's own tick() qualified, which the compiler can inline.
+template<typename T>
+struct StaticTick {
+    using type = T;
+    static bool accepts(T& component) {return true;}
+    static void tick(T& component) {component.T::tick();}
+    static void post_tick(T& component) {
+        component.for_each_output([](auto& port){ port.update(); });
+    }
+};
+
+// event boundary finder with do_parse (NE>1) fixed at compile time
+template<bool DO_PARSE>
+struct StaticEventBoundaryFinder : StaticTick<EventBoundaryFinder> {
+    static bool accepts(EventBoundaryFinder& component) {return component.do_parse == DO_PARSE;}
+    static void tick(EventBoundaryFinder& component) {component.template tick_impl<DO_PARSE>();}
+};
+
+// data player with the trigger mode (RANDOM_L1) fixed at compile time
+template<bool RANDOM_L1>
+struct StaticChipDataPlayer : StaticTick<ChipDataPlayer> {
+    static bool accepts(ChipDataPlayer& component) {return component.is_random_l1() == RANDOM_L1;}
+    static void tick(ChipDataPlayer& component) {component.template tick_impl<RANDOM_L1>();}
+};
+
+// Circuit whose component types are known at compile time, each Ts is a StaticTick-like policy.
+// Components are still added through Circuit::add_component, at the first tick they are sorted into
+// one list per type, so the tick becomes a sequence of type-homogeneous loops without virtual calls.
+// Every component has to match one of the types (and its compile-time switches), otherwise tick() throws.
+// fast_forward() and the partitions are inherited unchanged from Circuit.
+template<typename... Ts>
+class StaticCircuit : public Circuit {
+    public:
+        StaticCircuit() : Circuit() {};
+        void tick() override {
+            if (scheduled_components != components.size()) schedule();
+            TickProfiler* sampled = nullptr;
+#ifdef DTCQ_PROFILE
+            sampled = start_profiled_tick();
+#endif
+            std::apply([sampled](auto&... lists){ (tick_list(lists, sampled), ...); }, typed_components);
+            if (signal_plane) {
+                PROFILE_SECTION(sampled, 0, signal_plane_section);
+                signal_plane->swap();
+            }
+            else std::apply([sampled](auto&... lists){ (post_tick_list(lists, sampled), ...); }, typed_components);
+        }
+    private:
+        template<typename Policy>
+        struct TypedList {
+            using policy = Policy;
+            vector<typename Policy::type*> list;
+        };
+
+        template<typename List>
+        static void tick_list(List& typed, TickProfiler* sampled) {
+            for (auto component : typed.list) {
+                PROFILE_COMPONENT(sampled, 0, component, PHASE_TICK);
+                List::policy::tick(*component);
+            }
+        }
+        template<typename List>
+        static void post_tick_list(List& typed, TickProfiler* sampled) {
+            for (auto component : typed.list) {
+                PROFILE_COMPONENT(sampled, 0, component, PHASE_POST_TICK);
+                List::policy::post_tick(*component);
+            }
+        }
+        template<typename List>
+        static bool try_add(List& typed, Component* component) {
+            if (typeid(*component) != typeid(typename List::policy::type)) return false;
+            auto typed_component = static_cast<typename List::policy::type*>(component);
+            if (!List::policy::accepts(*typed_component)) return false;
+            typed.list.push_back(typed_component);
+            return true;
+        }
+
+        void schedule() {
+            std::apply([](auto&... lists){ (lists.list.clear(), ...); }, typed_components);
+            for (auto& component : components) {
+                Component* raw = component.get();
+                bool added = std::apply([raw](auto&... lists){ return (try_add(lists, raw) || ...); }, typed_components);
+                if (!added) {
+                    string msg = "StaticCircuit: no static type matches component ";
+                    msg += typeid(*raw).name();
+                    throw std::runtime_error(msg);
+                }
+            }
+            scheduled_components = components.size();
+        }
+
+        size_t scheduled_components = 0;
+        std::tuple<TypedList<Ts>...> typed_components;
+};
+#endif /* STATICCIRCUIT_H */
@@ -0,0 +1,118 @@
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+#include <include/Component.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+using namespace std;
+
+// Instrumentation of the circuit engines, compiled in only with -DDTCQ_PROFILE (cmake -DDTCQ_PROFILE=ON).
+// Every sample_period-th tick, the cycles and heap allocations of each component are added to the counters
+// of its type and phase. Allocations are counted by the operator new of TickProfiler.cpp, per thread.
+// The fan-out of the output ports and how often they propagate a change are collected from the ports at the end.
+
+// time stamp counter where available, otherwise nanoseconds
+inline uint64_t profile_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+// heap allocations made by the calling thread so far, always 0 without DTCQ_PROFILE
+uint64_t profile_thread_allocations();
+
+class TickProfiler {
+    public:
+        enum Phase {PHASE_TICK, PHASE_POST_TICK, PHASE_IDLE_TICKS, PHASE_SKIP_TICKS, NPHASES};
+        struct Counters {
+            unsigned long long calls = 0;
+            unsigned long long cycles = 0;
+            unsigned long long allocations = 0;
+        };
+
+        TickProfiler(int _nthreads, int _sample_period);
+        // give the components their profile_type, the components of a type share their counters
+        void register_components(const std::vector<std::shared_ptr<Component>>& components);
+        size_t get_registered_components() {return registered_components.size();}
+        // counters of something else than a component (e.g. the signal plane swap), timed on the same sampled ticks
+        int add_section(std::string name);
+        // called once per tick, true if the tick is sampled
+        bool start_tick() {
+            sampling = (ticks++ % sample_period) == 0;
+            if (sampling) sampled_ticks++;
+            return sampling;
+        }
+        bool is_sampling() {return sampling;}
+        void add_component_sample(int ithread, int type, Phase phase, uint64_t cycles, uint64_t allocations) {
+            add(thread_counters[ithread].types[size_t(type)*NPHASES + phase], cycles, allocations);
+        }
+        void add_section_sample(int ithread, int section, uint64_t cycles, uint64_t allocations) {
+            add(thread_counters[ithread].sections[section], cycles, allocations);
+        }
+        // counters summed over the threads, and the fan-out statistics of the ports, as a JSON object
+        void write_json(std::ostream& os);
+    private:
+        static void add(Counters& counters, uint64_t cycles, uint64_t allocations) {
+            counters.calls++;
+            counters.cycles += cycles;
+            counters.allocations += allocations;
+        }
+        // counters of one thread, on their own cache lines
+        struct alignas(64) ThreadCounters {
+            std::vector<Counters> types; // type-major, NPHASES per type
+            std::vector<Counters> sections;
+        };
+        int nthreads;
+        unsigned long long sample_period;
+        unsigned long long ticks = 0;
+        unsigned long long sampled_ticks = 0;
+        bool sampling = false;
+        std::vector<std::string> type_names;
+        std::vector<std::string> section_names;
+        std::vector<Component*> registered_components;
+        std::vector<ThreadCounters> thread_counters;
+        // to convert cycles to seconds
+        uint64_t start_cycles;
+        std::chrono::steady_clock::time_point start_time;
+};
+
+// Adds the cycles and allocations of its lifetime to a component type or a section, if the tick is sampled
+class ProfileScope {
+    public:
+        ProfileScope(TickProfiler* _profiler, int _ithread, int _index, TickProfiler::Phase _phase) :
+            profiler(_profiler && _profiler->is_sampling() ? _profiler : nullptr), ithread(_ithread), index(_index), phase(_phase) {
+            if (!profiler) return;
+            start_allocations = profile_thread_allocations();
+            start_cycles = profile_cycles();
+        }
+        ~ProfileScope() {
+            if (!profiler) return;
+            uint64_t cycles = profile_cycles() - start_cycles;
+            uint64_t allocations = profile_thread_allocations() - start_allocations;
+            if (phase==TickProfiler::NPHASES) profiler->add_section_sample(ithread, index, cycles, allocations);
+            else profiler->add_component_sample(ithread, index, phase, cycles, allocations);
+        }
+    private:
+        TickProfiler* profiler;
+        int ithread;
+        int index;
+        TickProfiler::Phase phase;
+        uint64_t start_cycles = 0;
+        uint64_t start_allocations = 0;
+};
+
+#ifdef DTCQ_PROFILE
+#define PROFILE_COMPONENT(profiler, ithread, component, phase) ProfileScope profile_scope(profiler, ithread, (component)->profile_type, TickProfiler::phase)
+#define PROFILE_SECTION(profiler, ithread, section) ProfileScope profile_scope(profiler, ithread, section, TickProfiler::NPHASES)
+#else
+#define PROFILE_COMPONENT(profiler, ithread, component, phase)
+#define PROFILE_SECTION(profiler, ithread, section)
+#endif
+#endif /* TICKPROFILER_H */
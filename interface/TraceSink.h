@@ -0,0 +1,83 @@
+#ifndef TRACESINK_H
+#define TRACESINK_H
+#include <interface/OccupancyContainer.h>
+#include <include/StateStream.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+// Occupancy traces of many FIFOs written by a background thread.
+// The simulation thread copies the occupancy arrays of the registered sources (e.g. the lanes of the FIFOBanks)
+// into a row of the block being filled, one row per call to record(). Full blocks are handed over through a ring
+// of preallocated blocks to the writer thread, which reorders the rows into the columns of an occupancy container.
+// Handing over a block is a single atomic store, so the simulation thread only waits when the ring is full,
+// i.e. when the disk can't keep up; those waits are counted and reported as backpressure.
+class AsyncTraceSink {
+    public:
+        static const int rows_per_block = 1024;
+        static const int nblocks = 8;
+
+        AsyncTraceSink(std::unique_ptr<OccupancyContainerWriter> _container);
+        ~AsyncTraceSink();
+        AsyncTraceSink(const AsyncTraceSink&) = delete;
+        AsyncTraceSink& operator=(const AsyncTraceSink&) = delete;
+        // columns.size() occupancies read at each record(), which have to stay valid while the sink is running,
+        // written to these columns of the container
+        void add_source(const uint32_t* occupancies, const std::vector<int>& columns);
+        // allocate the blocks and start the writer thread, after all sources were added
+        bool start();
+        // n ticks with the current occupancies of the sources
+        void record(unsigned long long n) {
+            if (block_rows==rows_per_block) submit_block();
+            Block& block = blocks[filled_blocks % nblocks];
+            uint16_t* row = block.values.data() + size_t(block_rows) * nlanes;
+            for (auto& source : sources) {
+                for (int ilane=0; ilane<source.count; ilane++) row[ilane] = uint16_t(source.occupancies[ilane]);
+                row += source.count;
+            }
+            block.ticks[block_rows++] = n;
+        }
+        // write the last rows, wait for the writer thread and close the container; false if writing failed
+        bool close();
+        // the state of the container, once the writer thread has written all the rows recorded so far
+        void save_state(StateWriter& out);
+        void load_state(StateReader& in);
+        // times record() had to wait for the writer thread, and the total time waited in seconds
+        unsigned long long get_stalls() {return stalls;}
+        double get_stall_seconds() {return stall_seconds;}
+    private:
+        struct Source {
+            const uint32_t* occupancies;
+            int count;
+        };
+        struct Block {
+            std::vector<uint16_t> values; // row-major, nlanes per row
+            std::vector<unsigned long long> ticks; // ticks of each row
+            int nrows = 0;
+        };
+        void submit_block();
+        // hand over the rows recorded so far and wait until the writer thread has written them
+        void drain();
+        void writer();
+
+        std::vector<Source> sources;
+        int nlanes = 0;
+        std::unique_ptr<OccupancyContainerWriter> container;
+        std::vector<int> lane_columns; // column of the container of each lane of a row
+        std::vector<Block> blocks;
+        int block_rows = 0; // rows of the block being filled
+        // blocks handed over to and written by the writer thread since the start, the ring is full when they differ by nblocks
+        unsigned long long filled_blocks = 0;
+        std::atomic<unsigned long long> submitted_blocks {0};
+        std::atomic<unsigned long long> written_blocks {0};
+        std::atomic<bool> stop {false};
+        std::thread writer_thread;
+        bool running = false;
+        unsigned long long stalls = 0;
+        double stall_seconds = 0;
+};
+#endif /* TRACESINK_H */
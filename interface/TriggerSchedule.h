@@ -0,0 +1,79 @@
+#ifndef TRIGGERSCHEDULE_H
+#define TRIGGERSCHEDULE_H
+#include <include/CounterRNG.h>
+#include <include/StateStream.h>
+#include <stdint.h>
+#include <vector>
+#include <array>
+#include <assert.h>
+using namespace std;
+
+// Generates the bunch crossings of the accepted L1 triggers ahead of the clock.
+// Each non-empty bunch triggers with the same probability, so instead of tossing every bunch crossing
+// the number of non-empty bunches until the next trigger is drawn from a geometric distribution.
+// The trigger rule is applied with a ring of the most recent accepted triggers.
+class TriggerSchedule {
+    public:
+        TriggerSchedule(const bool* bunch_not_empty, int _bunches_per_orbit, int _bunches_per_trigger, bool _use_trigger_rule, uint64_t seed);
+
+        // an accepted trigger, with the potential and blocked triggers counted from the start of the run up to it,
+        // so that the counts can be published when the clock reaches the trigger rather than when it is generated
+        struct Trigger {
+            unsigned long long bunch_crossing = 0;
+            unsigned long long potential_trigger_counts = 0;
+            unsigned long long blocked_trigger_counts = 0;
+        };
+        // the next accepted trigger, removed from the schedule
+        const Trigger& pop_next() {
+            if (next_idx == batch.size()) fill_batch();
+            return batch[next_idx++];
+        }
+        // position in the schedule for checkpoints, the bunch pattern and rates come from the constructor
+        void save_state(StateWriter& out);
+        void load_state(StateReader& in);
+        // continue after the triggers already taken with another seed, e.g. in clones of a simulation
+        void reseed(uint64_t seed);
+
+        static const int trigger_rule_max_L1As = 8;
+        static const int trigger_rule_bunch_period = 130; // No more than 8 L1As within 130 bunch crossings;
+        static const int batch_size = 256; // accepted triggers generated at once
+    private:
+        void fill_batch();
+        // append accepted triggers to the batch until it has n
+        void generate(size_t n);
+        // bunch crossing of the n-th non-empty bunch since the start of the run
+        unsigned long long nth_non_empty_bunch_crossing(unsigned long long n) {
+            return n / non_empty_bunches.size() * bunches_per_orbit + non_empty_bunches[n % non_empty_bunches.size()];
+        }
+
+        const int bunches_per_orbit;
+        const bool use_trigger_rule;
+        std::vector<int> non_empty_bunches; // positions in the orbit of the non-empty bunches
+        double log_miss_probability; // log of the probability that a non-empty bunch doesn't trigger
+        CounterRNG rng;
+        unsigned long long next_non_empty_bunch = 0; // index of the first non-empty bunch not tossed yet
+        bool first_trigger = true;
+        std::array<unsigned long long, trigger_rule_max_L1As> recent_L1A_bunch_crossings; // ring of the last accepted triggers
+        int recent_L1A_head = 0; // oldest entry once the ring is full
+        int recent_L1A_count = 0;
+        std::vector<Trigger> batch;
+        size_t next_idx = 0;
+        // state the batch was generated from, to generate its first triggers again in reseed()
+        struct BatchStart {
+            uint64_t rng_seed = 0;
+            uint64_t rng_position = 0;
+            unsigned long long next_non_empty_bunch = 0;
+            bool first_trigger = true;
+            std::array<unsigned long long, trigger_rule_max_L1As> recent_L1A_bunch_crossings;
+            int recent_L1A_head = 0;
+            int recent_L1A_count = 0;
+            unsigned long long potential_trigger_counts = 0;
+            unsigned long long blocked_trigger_counts = 0;
+        };
+        BatchStart batch_start;
+
+        // counted as the triggers are generated, ahead of the clock
+        unsigned long long potential_trigger_counts = 0;
+        unsigned long long blocked_trigger_counts = 0;
+};
+#endif /* TRIGGERSCHEDULE_H */
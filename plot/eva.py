@@ -2,6 +2,7 @@
 
 import argparse
 import re,os,sys
+import json
 import numpy as np
 from matplotlib import pyplot as plt
 from scipy.special import erf
@@ -35,8 +36,7 @@ def extract_period(path):
     else:
         raise ValueError("unable to extract period from input path")
 
-def fit_eva(data, period, fifo_name, ostream, outdir):
-    # bootstrapping
+def bootstrap_maxima(data, period, outdir):
     multipliers = [1,2,4,8,16,32,64]
     centers = []
     resampled_max = {}
@@ -51,10 +51,30 @@ def fit_eva(data, period, fifo_name, ostream, outdir):
     ax.set_ylabel("density")
     ax.legend()
     fig.savefig(f"{outdir}/histograms.png")
+    return [period*multiplier for multiplier in multipliers], centers
 
+def block_maxima_centers(ladder, fifo_name, outdir):
+    # medians of the block maxima of each period measured by the simulation (--block-maxima)
+    periods = []
+    centers = []
+    fig, ax = plt.subplots(1,1)
+    for level in ladder:
+        if level["maxima"]["entries"] == 0:
+            continue
+        periods.append(level["period"])
+        centers.append(level["maxima"]["p50"])
+        counts = np.array(level["maxima"]["counts"], dtype=float)
+        ax.stairs(counts/counts.sum(), np.arange(len(counts)+1)*64/1000, label="{:.2f} ms".format(level["period"]/FPGA_FREQUENCY))
+    ax.set_xlabel(r"max occpancy within $\tau$ (Kb)")
+    ax.set_ylabel("fraction of blocks")
+    ax.legend()
+    fig.savefig(f"{outdir}/histograms_{fifo_name}.png")
+    return periods, centers
+
+def fit_eva(periods, centers, fifo_name, ostream, outdir):
+    fig, ax = plt.subplots(1,1)
     # linear fit
-    tau = period / FPGA_FREQUENCY
-    lin_x = np.log10(tau*np.array(multipliers))
+    lin_x = np.log10(np.array(periods) / FPGA_FREQUENCY)
     lin_y = [c*64/1000 for c in centers]
     def lin(x, a, b):
         return a*x + b
@@ -92,12 +112,21 @@ def main():
     outdir = "EVA_result/{}".format(args.inpath.split("/")[-1])
     if not os.path.exists(outdir):
         os.makedirs(outdir)
+    block_maxima_fn = f"{args.inpath}/block_maxima.json"
+    block_maxima = None
+    if os.path.exists(block_maxima_fn):
+        with open(block_maxima_fn) as block_maxima_file:
+            block_maxima = json.load(block_maxima_file)
     with open(f"{outdir}/log.txt", "w") as ostream:
         for fifo_name in ["input_fifo", "output_fifo_data"]:
-            fname = f"{args.inpath}/period_max_{fifo_name}.bin"
-            data = np.fromfile(fname, dtype=np.uint16)
-            period = extract_period(args.inpath)
-            popt, popv = fit_eva(data, period, fifo_name, ostream, outdir)
+            if block_maxima is not None:
+                periods, centers = block_maxima_centers(block_maxima[fifo_name]["total"], fifo_name, outdir)
+            else:
+                fname = f"{args.inpath}/period_max_{fifo_name}.bin"
+                data = np.fromfile(fname, dtype=np.uint16)
+                period = extract_period(args.inpath)
+                periods, centers = bootstrap_maxima(data, period, outdir)
+            popt, popv = fit_eva(periods, centers, fifo_name, ostream, outdir)
             slope, intercept = popt
             var_slope = popv[0][0]
             var_intercept = popv[1][1]
@@ -0,0 +1,72 @@
+# Reader for the occupancy container written by dtc (interface/OccupancyContainer.h), memory-mapped with numpy.
+# Columns are returned as views of the mapping, only the chunks and chips asked for are paged in.
+import numpy as np
+
+MAGIC = b"DTCQOCCP"
+VERSION = 1
+FIFOS = ["input_fifo", "output_fifo_data"]
+HEADER = np.dtype([("magic", "S8"), ("version", "<u4"), ("nchips", "<u4"), ("nfifos", "<u4"), ("neb", "<u4"),
+                   ("total_ticks", "<u8"), ("nchunks", "<u8"), ("chips_offset", "<u8"), ("chunks_offset", "<u8"),
+                   ("columns_offset", "<u8"), ("file_bytes", "<u8"), ("padding", "V56")])
+CHIP = np.dtype([("index", "<i4"), ("dtc", "<i4"), ("barrel", "<i4"), ("layer", "<i4"), ("disk", "<i4"), ("module", "<i4"), ("chip", "<i4"),
+                 ("eb", "<i4"), ("index_in_eb", "<i4"), ("basename", "S64"), ("padding", "V28")])
+CHUNK = np.dtype([("first_tick", "<u8"), ("nticks", "<u8")])
+COLUMN = np.dtype([("offset", "<u8"), ("nchanges", "<u4"), ("reserved", "<u4")])
+
+class OccupancyContainer:
+    def __init__(self, file_name):
+        self.mapping = np.memmap(file_name, dtype=np.uint8, mode="r")
+        header = np.frombuffer(self.mapping, dtype=HEADER, count=1)[0]
+        if header["magic"] != MAGIC:
+            raise ValueError("{} is not an occupancy container".format(file_name))
+        if header["version"] != VERSION:
+            raise ValueError("{} has container version {}, expected {}".format(file_name, header["version"], VERSION))
+        if header["file_bytes"] != len(self.mapping):
+            raise ValueError("{} is truncated".format(file_name))
+        self.nchips = int(header["nchips"])
+        self.neb = int(header["neb"])
+        self.total_ticks = int(header["total_ticks"])
+        nchunks = int(header["nchunks"])
+        self.chips = np.frombuffer(self.mapping, dtype=CHIP, count=self.nchips, offset=int(header["chips_offset"]))
+        self.chunks = np.frombuffer(self.mapping, dtype=CHUNK, count=nchunks, offset=int(header["chunks_offset"]))
+        self.columns = np.frombuffer(self.mapping, dtype=COLUMN, count=nchunks * len(FIFOS) * self.nchips,
+                                     offset=int(header["columns_offset"])).reshape(nchunks, len(FIFOS), self.nchips)
+
+    def basenames(self):
+        return [basename.decode() for basename in self.chips["basename"]]
+
+    def chip_index(self, basename):
+        return self.basenames().index(basename)
+
+    def column(self, ichunk, fifo_name, ichip):
+        """(tick offsets from the chunk start, values) of the changes of a chip in a chunk, without copying."""
+        entry = self.columns[ichunk, FIFOS.index(fifo_name), ichip]
+        n = int(entry["nchanges"])
+        offset = int(entry["offset"])
+        return (np.frombuffer(self.mapping, dtype="<u4", count=n, offset=offset),
+                np.frombuffer(self.mapping, dtype="<u2", count=n, offset=offset + 4 * n))
+
+    def trace(self, fifo_name, ichip, first_tick=0, last_tick=None):
+        """(ticks, values) of the changes of a chip within [first_tick, last_tick), the first one at first_tick."""
+        if last_tick is None or last_tick > self.total_ticks:
+            last_tick = self.total_ticks
+        if first_tick >= last_tick:
+            return np.zeros(0, dtype=np.int64), np.zeros(0, dtype=np.int64)
+        first_chunk = max(int(np.searchsorted(self.chunks["first_tick"], first_tick, side="right")) - 1, 0)
+        last_chunk = int(np.searchsorted(self.chunks["first_tick"], last_tick, side="left"))
+        ticks = []
+        values = []
+        for ichunk in range(first_chunk, last_chunk):
+            tick_offsets, chunk_values = self.column(ichunk, fifo_name, ichip)
+            ticks.append(int(self.chunks["first_tick"][ichunk]) + tick_offsets.astype(np.int64))
+            values.append(chunk_values.astype(np.int64))
+        ticks = np.concatenate(ticks)
+        values = np.concatenate(values)
+        # the value at first_tick is the last change before it, and chunks repeat the value at their start
+        start = max(int(np.searchsorted(ticks, first_tick, side="right")) - 1, 0)
+        ticks = np.maximum(ticks[start:], first_tick)
+        values = values[start:]
+        in_window = ticks < last_tick
+        ticks, values = ticks[in_window], values[in_window]
+        changed = np.concatenate(([True], np.diff(values) != 0))
+        return ticks[changed], values[changed]
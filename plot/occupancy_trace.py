@@ -0,0 +1,69 @@
+# Reader for the per-chip FIFO occupancy traces (.trace) of older dtc outputs, and histograms of (ticks, values) traces
+import numpy as np
+
+MAGIC = b"DTCQTRCE"
+VERSION = 1
+BLOCK_HEADER = np.dtype([("first_tick", "<u8"), ("first_value", "<u2"), ("reserved", "<u2"), ("nchanges", "<u4"), ("nbytes", "<u4")])
+FOOTER = np.dtype([("total_ticks", "<u8"), ("nblocks", "<u8"), ("index_offset", "<u8"), ("magic", "S8")])
+
+def decode_varints(payload):
+    # little endian base 128, the last byte of each number has the high bit cleared
+    b = np.frombuffer(payload, dtype=np.uint8).astype(np.uint64)
+    if len(b) == 0:
+        return np.zeros(0, dtype=np.uint64)
+    last = (b & 0x80) == 0
+    starts = np.concatenate(([0], np.flatnonzero(last)[:-1] + 1))
+    position = np.arange(len(b)) - np.repeat(starts, np.diff(np.concatenate((starts, [len(b)]))))
+    return np.bitwise_or.reduceat((b & 0x7f) << (np.uint64(7) * position.astype(np.uint64)), starts)
+
+def read_trace(file_name):
+    """Returns (ticks, values, total_ticks): the occupancy is values[i] from ticks[i] up to the next change or total_ticks."""
+    with open(file_name, "rb") as f:
+        data = f.read()
+    if data[:8] != MAGIC or data[-8:] != MAGIC:
+        raise ValueError("{} is not an occupancy trace".format(file_name))
+    version = int(np.frombuffer(data, dtype="<u4", count=1, offset=8)[0])
+    if version != VERSION:
+        raise ValueError("{} has trace version {}, expected {}".format(file_name, version, VERSION))
+    footer = np.frombuffer(data, dtype=FOOTER, count=1, offset=len(data) - FOOTER.itemsize)[0]
+    total_ticks = int(footer["total_ticks"])
+    index = np.frombuffer(data, dtype="<u8", count=2 * int(footer["nblocks"]), offset=int(footer["index_offset"])).reshape(-1, 2)
+    ticks = []
+    values = []
+    for first_tick, offset in index:
+        header = np.frombuffer(data, dtype=BLOCK_HEADER, count=1, offset=int(offset))[0]
+        payload_offset = int(offset) + BLOCK_HEADER.itemsize
+        pairs = decode_varints(data[payload_offset:payload_offset + int(header["nbytes"])]).reshape(-1, 2)
+        assert len(pairs) == header["nchanges"]
+        zigzag = pairs[:, 1].astype(np.int64)
+        value_deltas = (zigzag >> 1) ^ -(zigzag & 1)
+        ticks.append(np.concatenate(([int(header["first_tick"])], int(header["first_tick"]) + np.cumsum(pairs[:, 0].astype(np.int64)))))
+        values.append(np.concatenate(([int(header["first_value"])], int(header["first_value"]) + np.cumsum(value_deltas))))
+    if not ticks:
+        return np.zeros(0, dtype=np.int64), np.zeros(0, dtype=np.int64), total_ticks
+    ticks = np.concatenate(ticks)
+    values = np.concatenate(values)
+    # a block starts at the last change of the previous one
+    keep = np.concatenate((np.diff(ticks) > 0, [True])) if len(ticks) > 1 else np.ones(1, dtype=bool)
+    return ticks[keep], values[keep], total_ticks
+
+def durations(ticks, total_ticks):
+    """Number of ticks each value of a trace lasts, up to total_ticks."""
+    ends = np.minimum(np.concatenate((ticks[1:], [total_ticks])), total_ticks)
+    return np.maximum(ends - ticks, 0)
+
+def histogram(ticks, values, total_ticks, nbins):
+    """Number of ticks spent at each occupancy below nbins."""
+    in_range = values < nbins
+    return np.bincount(values[in_range], weights=durations(ticks, total_ticks)[in_range], minlength=nbins)[:nbins]
+
+def sum_traces(traces, total_ticks):
+    """Sum of several (ticks, values) traces, as one trace."""
+    all_ticks = np.concatenate([ticks for ticks, _ in traces])
+    all_deltas = np.concatenate([np.diff(values, prepend=0) for _, values in traces])
+    order = np.argsort(all_ticks, kind="stable")
+    all_ticks = all_ticks[order]
+    total = np.cumsum(all_deltas[order])
+    # the sum after the last change at each tick
+    last_at_tick = np.concatenate((np.diff(all_ticks) > 0, [True]))
+    return all_ticks[last_at_tick], total[last_at_tick]
@@ -10,6 +10,9 @@ from tqdm import tqdm
 import csv
 import uproot
 import  warnings
+import json
+import occupancy_trace
+import occupancy_container
 
 class Chip:
     def from_filename(self, file_name_str):
@@ -97,7 +100,25 @@ def load_fifo_data(data_dir : str, data : dict, fifo_name : str) -> None:
     #    "tick" : [0],
     #    "max_buffer" : [0],
     #    } for _ in range(nchips)]
-    # define input files
+    # occupancy traces written by dtc, only the changes are stored
+    trace_fns = ["{}/{}_{}.trace".format(data_dir, fifo_name, data["chip"][ichip].basename) for ichip in range(nchips)]
+    if all(os.path.exists(trace_fn) for trace_fn in trace_fns):
+        print("reading buffer occupancy traces for {}".format(fifo_name))
+        traces = []
+        total_ticks_per_file = []
+        for ichip in tqdm(range(nchips)):
+            ticks, values, total_ticks = occupancy_trace.read_trace(trace_fns[ichip])
+            data[f"h_{fifo_name}_perchip"][ichip] += occupancy_trace.histogram(ticks, values, total_ticks, maxsize_perchip).astype(np.uint64)
+            traces.append((ticks, values))
+            total_ticks_per_file.append(total_ticks)
+        if max(total_ticks_per_file) > min(total_ticks_per_file):
+            warnings.warn("input files don't have the same number of ticks.")
+        nticks = min(total_ticks_per_file)
+        print("recognize number of ticks = {}".format(nticks))
+        ticks, values = occupancy_trace.sum_traces(traces, nticks)
+        data[f"h_{fifo_name}_total"] += occupancy_trace.histogram(ticks, values, nticks, maxsize_total).astype(np.uint64)
+        return
+    # raw dumps of older outputs, one uint16 per tick
     input_fns = ["{}/{}_{}.bin".format(data_dir, fifo_name, data["chip"][ichip].basename) for ichip in range(nchips)]
     # check file size, each clock tick will record 16bit for buffer occupancy == 2 bytes
     # size / 2 should indicate number of clock ticks recorded, which should be ubiquitous among files
@@ -136,7 +157,43 @@ def load_fifo_data(data_dir : str, data : dict, fifo_name : str) -> None:
     #    data[f"xt_{fifo_name}_perchip"][ichip]["max_buffer"].append(data[f"xt_{fifo_name}_perchip"][ichip]["max_buffer"][-1]);
     pbar.close()
 
-def load_data(data_dir, cache_file_name="", force_reload=False):
+# same histograms as load_fifo_data, from the occupancy container written by dtc,
+# only for the chips ichips (in the order of data["chip"]) and the ticks in [first_tick, last_tick)
+def load_fifo_container(container, data : dict, fifo_name : str, ichips, first_tick=0, last_tick=None) -> None:
+    nchips = len(ichips)
+    maxsize_perchip = 4092
+    maxsize_total = int(nchips * maxsize_perchip / 2)
+    if last_tick is None or last_tick > container.total_ticks:
+        last_tick = container.total_ticks
+    data[f"h_{fifo_name}_perchip"] = np.zeros(shape=(nchips, maxsize_perchip),dtype=np.uint64)
+    print("reading buffer occupancies for {} in ticks [{}, {})".format(fifo_name, first_tick, last_tick))
+    traces = []
+    for i, ichip in enumerate(tqdm(ichips)):
+        ticks, values = container.trace(fifo_name, ichip, first_tick, last_tick)
+        data[f"h_{fifo_name}_perchip"][i] += occupancy_trace.histogram(ticks, values, last_tick, maxsize_perchip).astype(np.uint64)
+        traces.append((ticks, values))
+    ticks, values = occupancy_trace.sum_traces(traces, last_tick)
+    data[f"h_{fifo_name}_total"] = occupancy_trace.histogram(ticks, values, last_tick, maxsize_total).astype(np.uint64)
+
+# same histograms as load_fifo_data, from the occupancy_summary.json written by dtc
+def load_fifo_summary(summary_fn : str, data : dict, fifo_name : str) -> None:
+    with open(summary_fn) as summary_file:
+        summary = json.load(summary_file)[fifo_name]
+    nchips = len(data["chip"])
+    maxsize_perchip = 4092
+    maxsize_total = int(nchips * maxsize_perchip / 2)
+    def to_bins(counts, nbins):
+        h = np.zeros(nbins, dtype=np.uint64)
+        counts = np.array(counts[:nbins], dtype=np.uint64)
+        h[:len(counts)] = counts
+        return h
+    data[f"h_{fifo_name}_perchip"] = np.array([to_bins(summary["chips"][chip.basename]["counts"], maxsize_perchip) for chip in data["chip"]])
+    data[f"h_{fifo_name}_total"] = to_bins(summary["total"]["counts"], maxsize_total)
+    data[f"h_{fifo_name}_per_eb"] = [np.array(eb["counts"], dtype=np.uint64) for eb in summary["event_builders"]]
+    print("loaded {} occupancy histograms, total p99={} p99.99={}".format(fifo_name, summary["total"]["p99"], summary["total"]["p9999"]))
+
+# chips and tick_window=(first_tick, last_tick) restrict the occupancies to some chip basenames and ticks, they need occupancy.dtcq
+def load_data(data_dir, cache_file_name="", force_reload=False, chips=None, tick_window=None):
     # if there is cache file, load it
     if cache_file_name and os.path.exists(cache_file_name) and not force_reload:
         try:
@@ -153,17 +210,32 @@ def load_data(data_dir, cache_file_name="", force_reload=False):
     data = {}
 
     # read the ordered input file names, so that we can match to the physical location of each chip
-    with open("{}/ordered_chips.csv".format(data_dir)) as ordered_chips_txt:
-        csv_reader = csv.DictReader(ordered_chips_txt, delimiter=" ",skipinitialspace=True)
-        data['chip'] = [Chip().from_dict(row) for row in csv_reader]
+    container_fn = "{}/occupancy.dtcq".format(data_dir)
+    container = None
+    if os.path.exists(container_fn):
+        container = occupancy_container.OccupancyContainer(container_fn)
+        ichips = list(range(container.nchips)) if not chips else [container.chip_index(basename) for basename in chips]
+        data['chip'] = [Chip().from_dict({key: container.chips[key][ichip] for key in ["index", "dtc", "barrel", "layer", "disk", "module", "chip"]}) for ichip in ichips]
+    else:
+        if chips or tick_window:
+            raise ValueError("selecting chips or ticks needs {}".format(container_fn))
+        with open("{}/ordered_chips.csv".format(data_dir)) as ordered_chips_txt:
+            csv_reader = csv.DictReader(ordered_chips_txt, delimiter=" ",skipinitialspace=True)
+            data['chip'] = [Chip().from_dict(row) for row in csv_reader]
     nchips = len(data['chip'])
 
     # load the distribution of event sizes (perchip or total)
     load_event_size(data_dir, data)
 
-    # load the distribution of buffer usage
+    # load the distribution of buffer usage, from the histograms filled by dtc when available
+    summary_fn = "{}/occupancy_summary.json".format(data_dir)
     for fifo_name in ["input_fifo", "output_fifo_data"]:
-        load_fifo_data(data_dir, data, fifo_name)
+        if os.path.exists(summary_fn) and not chips and not tick_window:
+            load_fifo_summary(summary_fn, data, fifo_name)
+        elif container is not None:
+            load_fifo_container(container, data, fifo_name, ichips, *(tick_window or (0, None)))
+        else:
+            load_fifo_data(data_dir, data, fifo_name)
 
     # Save data into cache file
     if cache_file_name:
@@ -387,34 +459,44 @@ def log_average_event_size(data, outdir):
             ostream.write("\t{:3.2f}\n".format(avg_evt_size))
     print("logged average event size in {}/eventsize.log".format(outdir))
 
-# read the text file for the chips' assignments to event builders
+# read the chips' assignments to event builders, from the occupancy container or the text file
 # also plot the distribution of number of chips assigned to each event builder
 def get_eb_assignment(inpath, outdir):
-    with open("{}/eb_assignment.txt".format(inpath)) as f:
-        # read the first line and plot the distribution
-        line = f.readline().replace("\t\n","")
-        nchips_per_eb_strings = line.split("\t")
-        nchips_per_eb = np.array([int(nchips_per_eb_string) for nchips_per_eb_string in nchips_per_eb_strings])
-        fig, ax = plt.subplots(1,1)
-        plt.hist(nchips_per_eb)
-        ax.set_xlabel("nchips assigned")
-        ax.set_ylabel("EB counts")
-        plot_filename = "{}/eb_assignment_dist.png".format(outdir)
-        fig.savefig(plot_filename)
-        print("plotted distribution of nchips assigned to event builders as {}".format(plot_filename))
-
-        # read the following lines for individual chip assignments
-        neb = len(nchips_per_eb)
-        eb_assignment = {}
-        for ieb in range(neb):
+    container_fn = "{}/occupancy.dtcq".format(inpath)
+    eb_assignment = {}
+    if os.path.exists(container_fn):
+        container = occupancy_container.OccupancyContainer(container_fn)
+        basenames = container.basenames()
+        for ieb in range(container.neb):
+            ichips = np.flatnonzero(container.chips["eb"] == ieb)
+            ichips = ichips[np.argsort(container.chips["index_in_eb"][ichips])]
+            eb_assignment[ieb] = [basenames[ichip] for ichip in ichips]
+        nchips_per_eb = np.array([len(eb_assignment[ieb]) for ieb in range(container.neb)])
+    else:
+        with open("{}/eb_assignment.txt".format(inpath)) as f:
+            # read the first line for the distribution
             line = f.readline().replace("\t\n","")
-            if not line:
-                raise Exception("Error reading eb assignment file.")
-            line_split_strings = line.split("\t")
-            # format checking
-            assert(line_split_strings[0] == "{}:".format(ieb))
-            assert("sum_of_avgsize" in line_split_strings[-1])
-            eb_assignment[ieb] = line_split_strings[1:-1]
+            nchips_per_eb_strings = line.split("\t")
+            nchips_per_eb = np.array([int(nchips_per_eb_string) for nchips_per_eb_string in nchips_per_eb_strings])
+
+            # read the following lines for individual chip assignments
+            neb = len(nchips_per_eb)
+            for ieb in range(neb):
+                line = f.readline().replace("\t\n","")
+                if not line:
+                    raise Exception("Error reading eb assignment file.")
+                line_split_strings = line.split("\t")
+                # format checking
+                assert(line_split_strings[0] == "{}:".format(ieb))
+                assert("sum_of_avgsize" in line_split_strings[-1])
+                eb_assignment[ieb] = line_split_strings[1:-1]
+    fig, ax = plt.subplots(1,1)
+    plt.hist(nchips_per_eb)
+    ax.set_xlabel("nchips assigned")
+    ax.set_ylabel("EB counts")
+    plot_filename = "{}/eb_assignment_dist.png".format(outdir)
+    fig.savefig(plot_filename)
+    print("plotted distribution of nchips assigned to event builders as {}".format(plot_filename))
     return eb_assignment
 
 def commandline():
@@ -428,6 +510,8 @@ def commandline():
     parser.add_argument('--total-only', action='store_true', help='Plot only the plot for the sum of buffering between all fifos.')
     #parser.add_argument('--log-average-event-size', action='store_true', help='generate a log file containing average event size for each chip')
     parser.add_argument('--tag', type=str, default="", help='Add a tag to be appeneded to the output dir name')
+    parser.add_argument('--chips', type=str, nargs='+', default=None, help='Load only these chips (basenames), needs occupancy.dtcq. Not cached.')
+    parser.add_argument('--tick-window', type=int, nargs=2, default=None, metavar=('FIRST', 'LAST'), help='Load only the occupancies of the ticks in [FIRST, LAST), needs occupancy.dtcq. Not cached.')
     #parser.add_argument('--compare', type=str, default="", help='Compare to a different version, use the path that include the output plots. Comparison is done in buffer distribution plot only.')
     args = parser.parse_args()
     return args
@@ -441,7 +525,10 @@ def main():
         os.makedirs(outdir)
     eb_assignment = get_eb_assignment(args.inpath, outdir)
     cache_file_name = "{}/data.pkl".format(outdir)
-    data = load_data(args.inpath, cache_file_name, args.force_reload)
+    # a selection is quick to load from the container, and must not overwrite the cache of the whole run
+    if args.chips or args.tick_window:
+        cache_file_name = ""
+    data = load_data(args.inpath, cache_file_name, args.force_reload, args.chips, args.tick_window)
     if args.no_plot:
         print("no plot generated.")
         return
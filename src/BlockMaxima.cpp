@@ -0,0 +1,30 @@
+#include <interface/BlockMaxima.h>
+
+using namespace std;
+
+void BlockMaximaLadder::close_block() {
+    ticks_in_block = 0;
+    closed_blocks++;
+    for (int iseries=0; iseries<nseries; iseries++) {
+        uint32_t* block_maxima = &partial_maxima[size_t(iseries)*nlevels];
+        OccupancyHistogram* series_histograms = &histograms[size_t(iseries)*nlevels];
+        // level k closes every 2^k base blocks and passes its maximum on to level k+1
+        for (int ilevel=0; ilevel<nlevels; ilevel++) {
+            series_histograms[ilevel].add(block_maxima[ilevel], 1);
+            if (ilevel+1<nlevels) block_maxima[ilevel+1] = std::max(block_maxima[ilevel+1], block_maxima[ilevel]);
+            block_maxima[ilevel] = 0;
+            if (closed_blocks % (2ull<<ilevel) != 0) break;
+        }
+    }
+}
+
+void BlockMaximaLadder::write_json(std::ostream& os, int iseries) const {
+    os<<"[";
+    for (int ilevel=0; ilevel<nlevels; ilevel++) {
+        if (ilevel>0) os<<", ";
+        os<<"{\"period\": "<<get_period(ilevel)<<", \"maxima\": ";
+        get_histogram(iseries, ilevel).write_json(os);
+        os<<"}";
+    }
+    os<<"]";
+}
@@ -0,0 +1,118 @@
+#include <interface/CapacityPlanner.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+CapacityPlanner::CapacityPlanner(std::shared_ptr<const EventChipMatrix> events, const std::vector<int>& ticks_per_word, const std::vector<int>& _eb_assignment, int neb, double _ticks_per_trigger, bool do_parse) :
+    ticks_per_trigger(_ticks_per_trigger), eb_assignment(_eb_assignment) {
+    int nchips = events->get_nchips();
+    int nevents = events->get_nevents();
+    assert(ticks_per_word.size()==nchips && eb_assignment.size()==nchips && ticks_per_trigger>0);
+    // sums over the input events of the service times and their squares, and of the output words
+    std::vector<double> elink_words(nchips, 0);
+    std::vector<double> elink_square_words(nchips, 0);
+    std::vector<double> output_words(nchips, 0);
+    std::vector<double> boundary_finder_ticks(nchips, 0);
+    std::vector<double> boundary_finder_square_ticks(nchips, 0);
+    std::vector<double> eb_words(neb, 0);
+    std::vector<double> eb_square_words(neb, 0);
+    std::vector<double> event_eb_words(neb);
+    for (int ievent=0; ievent<nevents; ievent++) {
+        const EventChipMatrix::Entry* row = events->row(ievent);
+        std::fill(event_eb_words.begin(), event_eb_words.end(), 0.0);
+        for (int ichip=0; ichip<nchips; ichip++) {
+            double words = row[ichip].size/64.0;
+            double words_out = std::max(1.0, words);
+            double ticks = words_out + (do_parse ? row[ichip].parse_time : 0);
+            elink_words[ichip] += words;
+            elink_square_words[ichip] += words*words;
+            output_words[ichip] += words_out;
+            boundary_finder_ticks[ichip] += ticks;
+            boundary_finder_square_ticks[ichip] += ticks*ticks;
+            event_eb_words[eb_assignment[ichip]] += words_out;
+        }
+        for (int ieb=0; ieb<neb; ieb++) {
+            eb_words[ieb] += event_eb_words[ieb];
+            eb_square_words[ieb] += event_eb_words[ieb]*event_eb_words[ieb];
+        }
+    }
+    for (int ichip=0; ichip<nchips; ichip++) {
+        double words = elink_words[ichip]/nevents;
+        double square_words = elink_square_words[ichip]/nevents;
+        elinks.push_back(make_queue(words, words*ticks_per_word[ichip], square_words*ticks_per_word[ichip]*ticks_per_word[ichip], ticks_per_trigger));
+        boundary_finders.push_back(make_queue(output_words[ichip]/nevents, boundary_finder_ticks[ichip]/nevents, boundary_finder_square_ticks[ichip]/nevents, ticks_per_trigger));
+    }
+    for (int ieb=0; ieb<neb; ieb++) {
+        double words = eb_words[ieb]/nevents;
+        builders.push_back(make_queue(words, words, eb_square_words[ieb]/nevents, ticks_per_trigger));
+    }
+}
+
+CapacityPlanner::Queue CapacityPlanner::make_queue(double words_per_event, double mean_service, double mean_square_service, double ticks_per_trigger) {
+    Queue queue;
+    queue.words_per_event = words_per_event;
+    queue.utilization = mean_service/ticks_per_trigger;
+    if (queue.utilization>=1) {
+        queue.mean_wait = queue.p99_wait = queue.p9999_wait = std::numeric_limits<double>::infinity();
+        return queue;
+    }
+    queue.mean_wait = mean_square_service/ticks_per_trigger/(2*(1-queue.utilization));
+    queue.p99_wait = wait_quantile(queue, 0.99);
+    queue.p9999_wait = wait_quantile(queue, 0.9999);
+    return queue;
+}
+
+double CapacityPlanner::wait_quantile(const Queue& queue, double q) {
+    // most events don't wait at all when the queue is empty often enough
+    if (queue.utilization<=1-q || queue.mean_wait<=0) return 0;
+    return queue.mean_wait/queue.utilization*std::log(queue.utilization/(1-q));
+}
+
+int CapacityPlanner::get_overloaded_chips() const {
+    int n = 0;
+    for (int ichip=0; ichip<elinks.size(); ichip++) n += elinks[ichip].utilization>=1 || boundary_finders[ichip].utilization>=1;
+    return n;
+}
+
+int CapacityPlanner::get_overloaded_builders() const {
+    int n = 0;
+    for (const Queue& queue : builders) n += queue.utilization>=1;
+    return n;
+}
+
+void CapacityPlanner::write_queue_json(std::ostream& os, const Queue& queue) {
+    // JSON has no infinity, the waits of an overloaded queue are null
+    auto write_wait = [&](double wait) {
+        if (std::isinf(wait)) os<<"null";
+        else os<<wait;
+    };
+    os<<"{\"words_per_event\": "<<queue.words_per_event<<", \"utilization\": "<<queue.utilization;
+    os<<", \"mean_wait\": ";
+    write_wait(queue.mean_wait);
+    os<<", \"p99_wait\": ";
+    write_wait(queue.p99_wait);
+    os<<", \"p9999_wait\": ";
+    write_wait(queue.p9999_wait);
+    os<<"}";
+}
+
+void CapacityPlanner::write_json(std::ostream& os, const std::vector<std::string>& chip_names) const {
+    os<<"{\"ticks_per_trigger\": "<<ticks_per_trigger<<", \"overloaded_chips\": "<<get_overloaded_chips()<<", \"overloaded_event_builders\": "<<get_overloaded_builders()<<",\n";
+    os<<"\"event_builders\": [";
+    for (int ieb=0; ieb<builders.size(); ieb++) {
+        os<<(ieb>0 ? ",\n    " : "\n    ");
+        write_queue_json(os, builders[ieb]);
+    }
+    os<<"],\n\"chips\": {";
+    for (int ichip=0; ichip<elinks.size(); ichip++) {
+        os<<(ichip>0 ? ",\n    " : "\n    ")<<"\""<<chip_names[ichip]<<"\": {\"eb\": "<<eb_assignment[ichip]<<", \"elink\": ";
+        write_queue_json(os, elinks[ichip]);
+        os<<", \"boundary_finder\": ";
+        write_queue_json(os, boundary_finders[ichip]);
+        os<<"}";
+    }
+    os<<"}}"<<std::endl;
+}
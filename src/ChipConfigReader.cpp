@@ -92,14 +92,14 @@ vector<int> ChipConfigReader::assign_chips_as_original(vector<string> chip_basen
     return assignment;
 }
 
-vector<int> ChipConfigReader::assign_chips_as_random(vector<string> chip_basename_list, int n_event_builders) {
+vector<int> ChipConfigReader::assign_chips_as_random(vector<string> chip_basename_list, int n_event_builders, uint64_t seed) {
     assert(n_event_builders>0);
     vector<float> chip_avg_size = this->GetAvgSizeVector(chip_basename_list);
     float sum_of_size = accumulate(chip_avg_size.begin(), chip_avg_size.end(), float(0));
     float size_threshold_per_eb = sum_of_size / n_event_builders;
     vector<int> shuffled_chips(chip_basename_list.size(), 0);
     for (int i=0; i<shuffled_chips.size(); i++) shuffled_chips[i]=i;
-    std::shuffle(shuffled_chips.begin(), shuffled_chips.end(), std::default_random_engine(233));
+    std::shuffle(shuffled_chips.begin(), shuffled_chips.end(), CounterRNG(seed, RNG_STREAM_ASSIGNMENT));
     vector<int> assignment(chip_basename_list.size(),-1);
     vector<float> allocated_sizes(n_event_builders, 0);
     std::cout<<"Assigning chips randomly... Sum of event size="<<sum_of_size<<" threshold="<<size_threshold_per_eb<<std::endl;
@@ -139,14 +139,14 @@ vector<int> ChipConfigReader::assign_chips_as_sorted(vector<string> chip_basenam
     return assignment;
 }
 
-vector<int> ChipConfigReader::assign_chips_to_event_builders(vector<string> chip_basename_list, int n_event_builders, std::string mode) {
+vector<int> ChipConfigReader::assign_chips_to_event_builders(vector<string> chip_basename_list, int n_event_builders, std::string mode, uint64_t seed) {
     // assign chips according to their original order in the config file
     if (mode=="original"){
         return this->assign_chips_as_original(chip_basename_list, n_event_builders);
     }
     // assign chips randomly but also try to balance load
     else if (mode=="random"){
-        return this->assign_chips_as_random(chip_basename_list, n_event_builders);
+        return this->assign_chips_as_random(chip_basename_list, n_event_builders, seed);
     }
     else if (mode=="sorted"){
         return this->assign_chips_as_sorted(chip_basename_list, n_event_builders);
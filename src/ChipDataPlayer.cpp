@@ -2,16 +2,16 @@
 
 using namespace std;
 
-ChipDataPlayer::ChipDataPlayer(int _nchips, vector<vector<unsigned short>> _vec_event_chip_sizes, vector<vector<unsigned short>> _vec_event_chip_parse_time, vector<float> elink_chip_ratio, int _NE, bool is_random_l1, bool use_trigger_rule) : 
+ChipDataPlayer::ChipDataPlayer(int _nchips, std::shared_ptr<const EventChipMatrix> _event_chip_matrix, vector<float> elink_chip_ratio, int _NE, bool is_random_l1, bool use_trigger_rule, uint64_t seed) : 
     Component(), out_read(_nchips), out_data(_nchips),
     RANDOM_L1(is_random_l1), TRIGGER_RULE(use_trigger_rule),
-    max_event_idx(_vec_event_chip_sizes.size()), new_event_flag(_nchips, true),
-    vec_event_chip_sizes(_vec_event_chip_sizes), NE(_NE),
-    remaining_bits_for_triggered_events(_nchips),
-    queued_empty_event(_nchips), queued_chip_parse_time(_nchips),
-    vec_event_chip_parse_time(_vec_event_chip_parse_time)
+    event_rng(seed, RNG_STREAM_EVENT_SAMPLING),
+    max_event_idx(_event_chip_matrix->get_nevents()), new_event_flag(_nchips, true),
+    event_chip_matrix(_event_chip_matrix), NE(_NE),
+    queued_empty_event(_nchips), triggered_event_ring(64), triggered_event_chips_left(64),
+    chip_trigger_cursor(_nchips, 0), chip_remaining_bits(_nchips, 0)
     {
-    assert(_nchips == vec_event_chip_sizes[0].size());
+    assert(_nchips == event_chip_matrix->get_nchips());
     assert(_nchips == elink_chip_ratio.size());
     nchips = _nchips;
     for (int ichip=0; ichip<nchips; ichip++) {
@@ -19,7 +19,23 @@ ChipDataPlayer::ChipDataPlayer(int _nchips, vector<vector<unsigned short>> _vec_
         add_output( &(out_data[ichip]) );
         assert( elink_chip_ratio[ichip]>0 );
         ticks_per_word.push_back( int(1.0*ticks_per_word_per_elink/elink_chip_ratio[ichip]) );
+        assert( ticks_per_word[ichip]>0 );
     }
+    // group the chips by e-link speed, the wheel spans the longest slot period
+    int max_ticks_per_word = 0;
+    for (int ichip=0; ichip<nchips; ichip++) {
+        int igroup = 0;
+        while (igroup<elink_groups.size() && elink_groups[igroup].ticks_per_word!=ticks_per_word[ichip]) igroup++;
+        if (igroup==elink_groups.size()) {
+            elink_groups.emplace_back();
+            elink_groups[igroup].ticks_per_word = ticks_per_word[ichip];
+        }
+        chip_elink_group.push_back(igroup);
+        max_ticks_per_word = std::max(max_ticks_per_word, ticks_per_word[ichip]);
+    }
+    chip_pending.assign(nchips, false);
+    words_sent.assign(nchips, 0);
+    emission_wheel.resize(max_ticks_per_word+1);
     // edit bunch_not_empty according to LHC filling scheme
     bool* position_in_orbit = bunch_not_empty;
     int non_empty_bunches = 0;
@@ -54,106 +70,266 @@ ChipDataPlayer::ChipDataPlayer(int _nchips, vector<vector<unsigned short>> _vec_
     assert( position_in_orbit - bunch_not_empty == bunches_per_orbit );
     // rescale the ticks per event to make final trigger rate being 750kHz
     ticks_per_event = 400*1000*non_empty_bunches/bunches_per_orbit/trigger_rate;
+    if (RANDOM_L1) {
+        trigger_schedule = std::make_unique<TriggerSchedule>(bunch_not_empty, bunches_per_orbit, ticks_per_event/10, TRIGGER_RULE, seed);
+        schedule_next_trigger();
+    }
+};
+
+ChipDataPlayer::ChipDataPlayer(int _nchips, std::shared_ptr<EventChunkStream> _event_stream, vector<float> elink_chip_ratio, int _NE, bool is_random_l1, bool use_trigger_rule, uint64_t seed) :
+    ChipDataPlayer(_nchips, _event_stream->next_chunk(), elink_chip_ratio, _NE, is_random_l1, use_trigger_rule, seed)
+    {
+    assert(_nchips == _event_stream->get_nchips());
+    event_stream = _event_stream;
 };
 
+// Take the next accepted trigger from the schedule. Trigger times and event choices come from their own
+// random streams, so looking ahead doesn't change the simulation but tells when the player has work to do.
+void ChipDataPlayer::schedule_next_trigger() {
+    if (event_stream && triggers_from_chunk==max_event_idx) {
+        // the triggers so far may still be sent from the old chunk
+        retired_chunks.emplace_back(triggered_events, event_chip_matrix);
+        event_chip_matrix = event_stream->next_chunk();
+        max_event_idx = event_chip_matrix->get_nevents();
+        triggers_from_chunk = 0;
+    }
+    triggers_from_chunk++;
+    next_trigger_event_row = event_chip_matrix->row(event_rng.uniform(max_event_idx));
+    // Check trigger every 25ns (10 clock ticks) at bunch crossings
+    next_trigger = trigger_schedule->pop_next();
+    next_trigger_tick = next_trigger.bunch_crossing * 10;
+}
+
 void ChipDataPlayer::tick() {
+    if (RANDOM_L1) tick_impl<true>();
+    else tick_impl<false>();
+}
+
+void ChipDataPlayer::push_trigger(const EventChipMatrix::Entry* event_row) {
+    // double the ring when the backlog of the slowest chip fills it
+    if (triggered_events - first_kept_trigger == triggered_event_ring.size()) {
+        std::vector<const EventChipMatrix::Entry*> ring(2*triggered_event_ring.size());
+        std::vector<int> chips_left(2*triggered_event_ring.size());
+        for (unsigned long long itrigger=first_kept_trigger; itrigger<triggered_events; itrigger++) {
+            ring[itrigger % ring.size()] = triggered_event_ring[itrigger % triggered_event_ring.size()];
+            chips_left[itrigger % ring.size()] = triggered_event_chips_left[itrigger % triggered_event_ring.size()];
+        }
+        triggered_event_ring.swap(ring);
+        triggered_event_chips_left.swap(chips_left);
+    }
+    triggered_event_ring[triggered_events % triggered_event_ring.size()] = event_row;
+    triggered_event_chips_left[triggered_events % triggered_event_ring.size()] = nchips;
+    triggered_events++;
+}
+
+void ChipDataPlayer::release_trigger(unsigned long long itrigger) {
+    triggered_event_chips_left[itrigger % triggered_event_ring.size()] -= 1;
+    while (first_kept_trigger<triggered_events && triggered_event_chips_left[first_kept_trigger % triggered_event_ring.size()]==0) first_kept_trigger++;
+    while (retired_chunks.size()>0 && retired_chunks.front().first<=first_kept_trigger) retired_chunks.pop_front();
+}
+
+void ChipDataPlayer::add_pending_chip(int ichip) {
+    if (chip_pending[ichip]) return;
+    chip_pending[ichip] = true;
+    int igroup = chip_elink_group[ichip];
+    elink_groups[igroup].pending_chips.push_back(ichip);
+    if (!elink_groups[igroup].scheduled) {
+        // simulates when e-link has capacity to transfer a new word, including the current tick
+        unsigned long long ticks_per_word_group = elink_groups[igroup].ticks_per_word;
+        schedule_group(igroup, (nticks + ticks_per_word_group - 1) / ticks_per_word_group * ticks_per_word_group);
+    }
+}
+
+void ChipDataPlayer::schedule_group(int igroup, unsigned long long tick) {
+    assert( tick - nticks < emission_wheel.size() );
+    emission_wheel[tick % emission_wheel.size()].push_back(igroup);
+    elink_groups[igroup].scheduled = true;
+}
+
+void ChipDataPlayer::emit_word(int ichip) {
+    words_sent[ichip]++;
+    // when padding < 8 bits, a new empty event with all zeroes is needed
+    // if this is what happened last time, will send an empty event this time
+    if (queued_empty_event[ichip]) {
+        queued_empty_event[ichip] = false;
+        out_read[ichip].set_value(true);
+        out_data[ichip].set_value(0ull);
+        return;
+    }
+    // Otherwise read data belong to the next event
+    // construct a 64 bits data word with:
+    // 1 bit: has new event boundary
+    // 2-8 bits: number of event boundaries
+    // k*8 + (1-8) bits: parsing time for events starting at the kth event boundary
+    // Note this is not the actual data format, just for convenience in simulation
+    bool has_event_boundary=false;
+    uint8_t number_of_boundaries=0;
+    uint8_t parsing_time_per_boundaries[7] = {0};
+    unsigned short remaining_bits_to_read = 64;
+    unsigned short& remaining_bits = chip_remaining_bits[ichip];
+    while (remaining_bits_to_read>0 && chip_trigger_cursor[ichip]<triggered_events) {
+        if (new_event_flag[ichip]) {
+            const EventChipMatrix::Entry& event_chip = triggered_event_ring[chip_trigger_cursor[ichip] % triggered_event_ring.size()][ichip];
+            remaining_bits = event_chip.size;
+            has_event_boundary = true;
+            parsing_time_per_boundaries[number_of_boundaries] = event_chip.parse_time;
+            number_of_boundaries += 1;
+            new_event_flag[ichip] = false;
+        }
+        int read_bits = min(remaining_bits_to_read, remaining_bits);
+        remaining_bits -= read_bits;
+        if (remaining_bits==0) {
+            release_trigger(chip_trigger_cursor[ichip]++);
+            new_event_flag[ichip] = true;
+        }
+        remaining_bits_to_read -= read_bits;
+    }
+    uint64_t value = ((uint64_t)has_event_boundary)<<7;
+    value = value | number_of_boundaries;
+    for (uint8_t parsing_time_iboundary : parsing_time_per_boundaries) {
+        value = value << 8;
+        value = value | parsing_time_iboundary;
+    }
+    //cerr<<"has_event_boundary="<<has_event_boundary<<"number_of_boundaries="<<number_of_boundaries<<endl;
+    //cerr<<bitset<64>(value)<<endl;
+    out_read[ichip].set_value(true);
+    out_data[ichip].set_value(value);
+}
+
+template<bool RANDOM_TRIGGER>
+void ChipDataPlayer::tick_impl() {
     // First part check if new event is triggered
-    if (RANDOM_L1) {
-        // Check trigger every 25ns (10 clock ticks) at bunch crossings
-        if (nticks%10==0) {
-            assert(nbunch<bunches_per_orbit);
-            // Implemented trigger rule: no more than 8 triggers 130 bunch crossings
-            for (int i=0; i<time_since_recent_L1As.size(); i++) time_since_recent_L1As[i]++;
-            if (time_since_recent_L1As.size()>0 && time_since_recent_L1As.front()>trigger_rule_bunch_period) time_since_recent_L1As.pop_front();
-            // first event always trigger, otherwise depends on the toss and trigger rule
-            //if ((time_since_recent_L1As.size()<trigger_rule_max_L1As && bunch_not_empty[nbunch] && rand()%int(ticks_per_event/10)==0) || (nticks==0)) {
-            if ((bunch_not_empty[nbunch] && rand()%int(ticks_per_event/10)==0) || (nticks==0)) {
-                potential_trigger_counts += 1;
-                if (time_since_recent_L1As.size()>=trigger_rule_max_L1As) {
-                    blocked_trigger_counts += 1;
-                    cout<<"Blocked trigger according to trigger rule, current ratio = "<<100.0*blocked_trigger_counts/potential_trigger_counts<<"%"<<endl;
-                }
-                else {
-                    triggered_events++;
-                    int triggered_event_idx = rand() % max_event_idx;
-                    // load the event size per chip for this event idx
-                    for (int ichip=0; ichip<nchips; ichip++) {
-                        remaining_bits_for_triggered_events[ichip].push_back(vec_event_chip_sizes[triggered_event_idx][ichip]);
-                        queued_chip_parse_time[ichip].push_back(vec_event_chip_parse_time[triggered_event_idx][ichip]);
-                    }
-                    if (TRIGGER_RULE) time_since_recent_L1As.push_back(0);
-                }
-            }
-            nbunch ++;
-            if (nbunch == bunches_per_orbit) nbunch = 0;
+    if constexpr (RANDOM_TRIGGER) {
+        if (nticks == next_trigger_tick) {
+            // the chips read the event size and parse time of this event idx when they start sending it
+            push_trigger(next_trigger_event_row);
+            potential_trigger_counts = next_trigger.potential_trigger_counts;
+            blocked_trigger_counts = next_trigger.blocked_trigger_counts;
+            for (int ichip=0; ichip<nchips; ichip++) add_pending_chip(ichip);
+            schedule_next_trigger();
         }
     }
     else {
         throw std::runtime_error("Flat trigger rate unimplemented.");
     }
 
-    // Check if link has enough bandwidth to send next event's data
-    for (int ichip=0; ichip<nchips; ichip++) {
-        bool trigger_condition = (remaining_bits_for_triggered_events[ichip].size()>0);
-        // simulates when e-link has capacity to transfer a new word
-        if (nticks%ticks_per_word[ichip]==0) {
-            // when padding < 8 bits, a new empty event with all zeroes is needed
-            // if this is what happened last time, will send an empty event this time
-            if (queued_empty_event[ichip]) {
-                value = 0ull;
-                queued_empty_event[ichip] = false;
-                out_read[ichip].set_value(true);
-                out_data[ichip].set_value(value);
-            }
-            // Otherwise try to read data belong to the next event
-            else if (remaining_bits_for_triggered_events[ichip].size()>0) {
-                // construct a 64 bits data word with:
-                // 1 bit: has new event boundary
-                // 2-8 bits: number of event boundaries
-                // k*8 + (1-8) bits: parsing time for events starting at the kth event boundary
-                // Note this is not the actual data format, just for convenience in simulation
-                bool has_event_boundary=false;
-                uint8_t number_of_boundaries=0;
-                vector<uint8_t> parsing_time_per_boundaries(7,0);
-                unsigned short remaining_bits_to_read = 64;
-                while (remaining_bits_to_read>0 && remaining_bits_for_triggered_events[ichip].size()>0) {
-                    if (new_event_flag[ichip]) {
-                        has_event_boundary = true;
-                        parsing_time_per_boundaries[number_of_boundaries] = queued_chip_parse_time[ichip].front();
-                        queued_chip_parse_time[ichip].pop_front();
-                        number_of_boundaries += 1;
-                        new_event_flag[ichip] = false;
-                    }
-                    int read_bits = min(remaining_bits_to_read, remaining_bits_for_triggered_events[ichip].front());
-                    remaining_bits_for_triggered_events[ichip].front() -= read_bits;
-                    if (remaining_bits_for_triggered_events[ichip].front()==0) {
-                        remaining_bits_for_triggered_events[ichip].pop_front();
-                        new_event_flag[ichip] = true;
-                    }
-                    remaining_bits_to_read -= read_bits;
-                }
-                value = ((uint64_t)has_event_boundary)<<7;
-                value = value | number_of_boundaries;
-                for (uint8_t parsing_time_iboundary : parsing_time_per_boundaries) {
-                    value = value << 8;
-                    value = value | parsing_time_iboundary;
-                }
-                //cerr<<"has_event_boundary="<<has_event_boundary<<"number_of_boundaries="<<number_of_boundaries<<endl;
-                //cerr<<bitset<64>(value)<<endl;
-                out_read[ichip].set_value(true);
-                out_data[ichip].set_value(value);
-            }
-            // If there is no triggered event, no signal sent
-            else {
-                out_read[ichip].set_value(false);
-                out_data[ichip].set_value(0ull);
-            }
-        }
-        // no signal sent if link un-available
-        else {
-            out_read[ichip].set_value(false);
-            out_data[ichip].set_value(0ull);
+    // no signal sent if link un-available or there is no triggered event
+    for (int ichip : chips_sent_last_tick) {
+        out_read[ichip].set_value(false);
+        out_data[ichip].set_value(0ull);
+    }
+    chips_sent_last_tick.clear();
+
+    // Send the next word of the chips whose e-link has capacity on this tick
+    std::vector<int>& due_groups = emission_wheel[nticks % emission_wheel.size()];
+    for (int igroup : due_groups) {
+        ElinkGroup& group = elink_groups[igroup];
+        group.scheduled = false;
+        int n_still_pending = 0;
+        for (int ichip : group.pending_chips) {
+            emit_word(ichip);
+            chips_sent_last_tick.push_back(ichip);
+            if (has_queued_word(ichip)) group.pending_chips[n_still_pending++] = ichip;
+            else chip_pending[ichip] = false;
         }
-    }// end for loop enumerating all chips
+        group.pending_chips.resize(n_still_pending);
+        if (n_still_pending>0) schedule_group(igroup, nticks + group.ticks_per_word);
+    }
+    due_groups.clear();
     nticks ++;
 }
+template void ChipDataPlayer::tick_impl<true>();
+template void ChipDataPlayer::tick_impl<false>();
+
+// idle until the next trigger or the next e-link slot of a chip with data, once all outputs are back to 0
+unsigned long long ChipDataPlayer::idle_ticks() {
+    if (!RANDOM_L1) return 0;
+    if (chips_sent_last_tick.size()>0) return 0;
+    unsigned long long n = next_trigger_tick - nticks;
+    for (ElinkGroup& group : elink_groups) {
+        if (!group.scheduled) continue;
+        unsigned long long ticks_to_next_word = (group.ticks_per_word - nticks%group.ticks_per_word) % group.ticks_per_word;
+        n = std::min(n, ticks_to_next_word);
+        if (n==0) return 0;
+    }
+    return n;
+}
+
+void ChipDataPlayer::skip_ticks(unsigned long long n) {
+    nticks += n;
+}
+
+void ChipDataPlayer::save_state(StateWriter& out) {
+    if (event_stream) throw std::runtime_error("the state of a player of a streamed input can't be saved");
+    Component::save_state(out);
+    if (trigger_schedule) trigger_schedule->save_state(out);
+    out.write(event_rng.get_seed());
+    out.write(event_rng.get_position());
+    out.write(nticks);
+    out.write(triggered_events);
+    out.write(next_trigger_tick);
+    out.write(next_trigger);
+    out.write(potential_trigger_counts);
+    out.write(blocked_trigger_counts);
+    out.write(row_index(next_trigger_event_row));
+    // the ring only holds the triggers that some chips haven't sent yet
+    out.write(first_kept_trigger);
+    for (unsigned long long itrigger=first_kept_trigger; itrigger<triggered_events; itrigger++) {
+        out.write(row_index(triggered_event_ring[itrigger % triggered_event_ring.size()]));
+        out.write(triggered_event_chips_left[itrigger % triggered_event_ring.size()]);
+    }
+    out.write(chip_trigger_cursor);
+    out.write(chip_remaining_bits);
+    out.write(new_event_flag);
+    out.write(queued_empty_event);
+    for (ElinkGroup& group : elink_groups) {
+        out.write(group.pending_chips);
+        out.write(group.scheduled);
+    }
+    out.write(chip_pending);
+    for (std::vector<int>& due_groups : emission_wheel) out.write(due_groups);
+    out.write(chips_sent_last_tick);
+    out.write(words_sent);
+}
+
+void ChipDataPlayer::load_state(StateReader& in) {
+    if (event_stream) throw std::runtime_error("the state of a player of a streamed input can't be restored");
+    Component::load_state(in);
+    if (trigger_schedule) trigger_schedule->load_state(in);
+    uint64_t event_seed = in.read<uint64_t>();
+    event_rng = CounterRNG(event_seed, RNG_STREAM_EVENT_SAMPLING, in.read<uint64_t>());
+    in.read(nticks);
+    in.read(triggered_events);
+    in.read(next_trigger_tick);
+    in.read(next_trigger);
+    in.read(potential_trigger_counts);
+    in.read(blocked_trigger_counts);
+    next_trigger_event_row = row_at(in.read<int64_t>());
+    in.read(first_kept_trigger);
+    size_t ring_size = 64;
+    while (ring_size <= triggered_events - first_kept_trigger) ring_size *= 2;
+    triggered_event_ring.assign(ring_size, nullptr);
+    triggered_event_chips_left.assign(ring_size, 0);
+    for (unsigned long long itrigger=first_kept_trigger; itrigger<triggered_events; itrigger++) {
+        triggered_event_ring[itrigger % ring_size] = row_at(in.read<int64_t>());
+        in.read(triggered_event_chips_left[itrigger % ring_size]);
+    }
+    in.read(chip_trigger_cursor);
+    in.read(chip_remaining_bits);
+    in.read(new_event_flag);
+    in.read(queued_empty_event);
+    assert(chip_trigger_cursor.size()==nchips && chip_remaining_bits.size()==nchips);
+    for (ElinkGroup& group : elink_groups) {
+        in.read(group.pending_chips);
+        in.read(group.scheduled);
+    }
+    in.read(chip_pending);
+    for (std::vector<int>& due_groups : emission_wheel) in.read(due_groups);
+    in.read(chips_sent_last_tick);
+    in.read(words_sent);
+}
+
+void ChipDataPlayer::reseed(uint64_t seed) {
+    if (trigger_schedule) trigger_schedule->reseed(seed);
+    event_rng = CounterRNG(seed, RNG_STREAM_EVENT_SAMPLING);
+}
@@ -0,0 +1,161 @@
+#include <interface/ChipTreeReader.h>
+#include <interface/EventChunkStream.h>
+#include <regex>
+#include <assert.h>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "TROOT.h"
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TList.h"
+#include "TKey.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
+
+using namespace std;
+
+std::string ChipInfo::basename() const {
+    std::string chip_basename("dtc");
+    chip_basename += std::to_string(dtc)    + "isBarrel";
+    chip_basename += std::to_string(barrel) + "layer";
+    chip_basename += std::to_string(layer)  + "disk";
+    chip_basename += std::to_string(disk)   + "module";
+    chip_basename += std::to_string(module_id) + "chip";
+    chip_basename += std::to_string(chip);
+    return chip_basename;
+}
+
+// the chip trees of dtcname in the order of the keys of its directory, objects owned by input_root_file
+static std::vector<TTree*> get_chip_trees(TFile* input_root_file, std::string dtcname) {
+    TDirectory* dtcdir = (TDirectory*) input_root_file->Get(dtcname.c_str());
+    assert(dtcdir); //make sure this directory exists in root file
+    std::vector<TTree*> vec_trees;
+    for (const auto && key : *dtcdir->GetListOfKeys()) {
+        vec_trees.push_back((TTree*) ((TKey*)key)->ReadObj());
+    }
+    return vec_trees;
+}
+
+// copy the events [first_event, first_event+nevents of the matrix) of one chip tree into column ichip of the matrix,
+// and the chip identification into chip_info unless it is null
+static void read_chip_tree(TTree* tree, int ichip, int first_event, EventChipMatrix& event_chip_matrix, ChipInfo* chip_info) {
+    static const std::regex rgx("module([0-9]+)chip([0-9]+)");
+    TTreeReader chip_reader(tree);
+    TTreeReaderValue<int>  branch_dtc          ( chip_reader , "dtc");
+    TTreeReaderValue<bool> branch_barrel       ( chip_reader , "barrel");
+    TTreeReaderValue<int>  branch_layer        ( chip_reader , "layer");
+    TTreeReaderValue<int>  branch_disk         ( chip_reader , "disk");
+    TTreeReaderValue<int>  branch_module_id    ( chip_reader , "module_id");
+    TTreeReaderValue<int>  branch_size_pad     ( chip_reader , "stream_size_chip_aurora_pad");
+    TTreeReaderValue<int>  branch_parse_time   ( chip_reader , "parsing_time");
+    chip_reader.SetEntriesRange(first_event, first_event + event_chip_matrix.get_nevents());
+    int ievent = 0;
+    while (chip_reader.Next()) {
+        assert(*branch_size_pad < 65536);
+        assert(*branch_parse_time < 65536);
+        event_chip_matrix.at(ievent, ichip) = {(unsigned short) *branch_size_pad, (unsigned short) *branch_parse_time};
+        if (ievent==0 && chip_info) {
+            std::smatch matches;
+            std::string treename = tree->GetName();
+            std::regex_search(treename, matches, rgx);
+            assert(matches.size()==3);
+            chip_info->tree_module = stoi(matches[1].str());
+            chip_info->dtc         = *branch_dtc;
+            chip_info->barrel      = *branch_barrel;
+            chip_info->layer       = *branch_layer;
+            chip_info->disk        = *branch_disk;
+            chip_info->module_id   = *branch_module_id;
+            chip_info->chip        = stoi(matches[2].str());
+        }
+        ievent += 1;
+    }
+    assert(ievent==event_chip_matrix.get_nevents());
+}
+
+// Streams the chip trees of a DTC, with the file kept open between chunks
+class RootChunkSource : public EventChunkSource {
+    public:
+        RootChunkSource(std::string root_file_name, std::string dtcname) {
+            // chunks are read on the prefetch thread
+            ROOT::EnableThreadSafety();
+            input_root_file = TFile::Open(root_file_name.c_str());
+            if (!input_root_file) throw std::runtime_error("Unable to open "+root_file_name);
+            vec_trees = get_chip_trees(input_root_file, dtcname);
+            assert(vec_trees.size()>0);
+            nevents = vec_trees[0]->GetEntries();
+            chips.resize(vec_trees.size());
+            EventChipMatrix first_event(1, vec_trees.size());
+            for (size_t ichip=0; ichip<vec_trees.size(); ichip++) read_chip_tree(vec_trees[ichip], ichip, 0, first_event, &chips[ichip]);
+        }
+        ~RootChunkSource() {
+            input_root_file->Close();
+        }
+        int get_nevents() override {return nevents;}
+        const std::vector<ChipInfo>& get_chips() override {return chips;}
+        std::shared_ptr<EventChipMatrix> read_chunk(int first_event, int chunk_events) override {
+            auto chunk = std::make_shared<EventChipMatrix>(chunk_events, vec_trees.size());
+            for (size_t ichip=0; ichip<vec_trees.size(); ichip++) read_chip_tree(vec_trees[ichip], ichip, first_event, *chunk, nullptr);
+            return chunk;
+        }
+    private:
+        TFile* input_root_file;
+        std::vector<TTree*> vec_trees;
+        int nevents;
+        std::vector<ChipInfo> chips;
+};
+
+std::shared_ptr<EventChunkSource> open_dtc_stream_from_root(std::string root_file_name, std::string dtcname) {
+    return std::make_shared<RootChunkSource>(root_file_name, dtcname);
+}
+
+DTCInput read_dtc_from_root(std::string root_file_name, std::string dtcname, int nthreads) {
+    if (nthreads>1) ROOT::EnableThreadSafety();
+    TFile* input_root_file = TFile::Open(root_file_name.c_str());
+    if (!input_root_file) throw std::runtime_error("Unable to open "+root_file_name);
+    std::vector<TTree*> vec_trees = get_chip_trees(input_root_file, dtcname);
+    int nchips = vec_trees.size();
+    assert(nchips>0);
+    int input_events = vec_trees[0]->GetEntries();
+    DTCInput input;
+    input.chips.resize(nchips);
+    input.event_chip_matrix = std::make_shared<EventChipMatrix>(input_events, nchips);
+    nthreads = std::max(1, std::min(nthreads, nchips));
+    // the chips are handed out one at a time, each thread reads them through its own TFile handle
+    // and writes only their columns of the matrix, so the result doesn't depend on the threads
+    std::atomic<int> next_chip(0);
+    std::vector<std::string> errors(nthreads);
+    auto read_chips = [&](int ithread) {
+        TFile* thread_root_file = input_root_file;
+        std::vector<TTree*> thread_trees = vec_trees;
+        if (ithread>0) {
+            thread_root_file = TFile::Open(root_file_name.c_str());
+            if (!thread_root_file) {errors[ithread] = "Unable to open "+root_file_name; return;}
+            thread_trees = get_chip_trees(thread_root_file, dtcname);
+            assert(int(thread_trees.size())==nchips);
+        }
+        for (int ichip=next_chip++; ichip<nchips; ichip=next_chip++) {
+            read_chip_tree(thread_trees[ichip], ichip, 0, *input.event_chip_matrix, &input.chips[ichip]);
+        }
+        if (ithread>0) thread_root_file->Close();
+    };
+    std::vector<std::thread> workers;
+    for (int ithread=1; ithread<nthreads; ithread++) workers.emplace_back(read_chips, ithread);
+    read_chips(0);
+    for (auto& t : workers) t.join();
+    input_root_file->Close();
+    for (auto& error : errors) if (!error.empty()) throw std::runtime_error(error);
+    return input;
+}
+
+std::vector<std::string> list_dtcs_in_root(std::string root_file_name) {
+    TFile* input_root_file = TFile::Open(root_file_name.c_str());
+    if (!input_root_file) throw std::runtime_error("Unable to open "+root_file_name);
+    std::vector<std::string> dtcnames;
+    for (const auto && key : *input_root_file->GetListOfKeys()) {
+        if (std::string(((TKey*)key)->GetClassName())=="TDirectoryFile") dtcnames.push_back(((TKey*)key)->GetName());
+    }
+    input_root_file->Close();
+    return dtcnames;
+}
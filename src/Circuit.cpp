@@ -1,10 +1,88 @@
 #include<interface/Circuit.h>
+#include<algorithm>
+#include<stdexcept>
+#include<assert.h>
 
 void Circuit::tick(){
+#ifdef DTCQ_PROFILE
+    TickProfiler* sampled = start_profiled_tick();
+#endif
     for(auto component : components) {
+        PROFILE_COMPONENT(sampled, 0, component, PHASE_TICK);
         component->tick();
     }
+    if (signal_plane) {
+        PROFILE_SECTION(sampled, 0, signal_plane_section);
+        signal_plane->swap();
+        return;
+    }
+    for(auto component : components) {
+        PROFILE_COMPONENT(sampled, 0, component, PHASE_POST_TICK);
+        component->post_tick();
+    }
+};
+
+void Circuit::enable_profiling(int sample_period){
+    profiler = std::make_unique<TickProfiler>(get_nthreads(), sample_period);
+    signal_plane_section = profiler->add_section("signal_plane_swap");
+};
+
+TickProfiler* Circuit::start_profiled_tick(){
+    if (!profiler) return nullptr;
+    if (profiler->get_registered_components()!=components.size()) profiler->register_components(components);
+    return profiler->start_tick() ? profiler.get() : nullptr;
+};
+
+void Circuit::use_signal_plane(){
+    assert(!signal_plane);
+    signal_plane = std::make_unique<SignalPlane>();
+    for(auto component : components) {
+        for(auto port : component->get_output_ports()) port->reserve_slot(*signal_plane);
+        signal_plane->align_bits();
+    }
+    signal_plane->allocate();
+    for(auto component : components) {
+        for(auto port : component->get_output_ports()) port->bind_slot(*signal_plane);
+    }
+    // outputs set before this point reach their inputs with the next swap, as they would with the next post_tick
+};
+
+void Circuit::save_state(StateWriter& out){
+    out.write<uint64_t>(components.size());
+    for(auto component : components) component->save_state(out);
+};
+
+void Circuit::load_state(StateReader& in){
+    if (in.read<uint64_t>()!=components.size()) throw std::runtime_error("the checkpoint is of a circuit with another number of components");
+    for(auto component : components) component->load_state(in);
+    // the restored outputs are in the next buffer of the plane, published as after a tick
+    if (signal_plane) signal_plane->swap();
+};
+
+unsigned long long Circuit::fast_forward(unsigned long long max_ticks){
+#ifdef DTCQ_PROFILE
+    // sampled along with the tick before
+    TickProfiler* sampled = profiler.get();
+#endif
+    unsigned long long n = max_ticks;
+    for(auto component : components) {
+        PROFILE_COMPONENT(sampled, 0, component, PHASE_IDLE_TICKS);
+        n = std::min(n, component->idle_ticks());
+        if (n==0) return 0;
+    }
+    for(auto component : components) {
+        PROFILE_COMPONENT(sampled, 0, component, PHASE_SKIP_TICKS);
+        component->skip_ticks(n);
+    }
+    // outputs changed by skip_ticks (e.g. toggling read requests) reach their inputs as after a normal tick
+    if (signal_plane) {
+        PROFILE_SECTION(sampled, 0, signal_plane_section);
+        signal_plane->swap();
+        return n;
+    }
     for(auto component : components) {
+        PROFILE_COMPONENT(sampled, 0, component, PHASE_POST_TICK);
         component->post_tick();
     }
-};
\ No newline at end of file
+    return n;
+};
@@ -0,0 +1,102 @@
+#include <interface/ConvergenceMonitor.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+void ConvergenceMonitor::add_batch(const std::vector<double>& values) {
+    assert(values.size()==names.size());
+    nbatches++;
+    for (size_t iseries=0; iseries<names.size(); iseries++) {
+        if (nbatches==1) first_values[iseries] = values[iseries];
+        else lag_products[iseries] += last_values[iseries]*values[iseries];
+        last_values[iseries] = values[iseries];
+        double delta = values[iseries] - means[iseries];
+        means[iseries] += delta/nbatches;
+        square_deviations[iseries] += delta*(values[iseries] - means[iseries]);
+    }
+}
+
+double ConvergenceMonitor::get_lag1_autocorrelation(int iseries) const {
+    if (nbatches<3 || square_deviations[iseries]<=0) return 0;
+    // sum over consecutive batches of (x_i-mean)*(x_i+1-mean), expanded around the final mean
+    double mean = means[iseries];
+    double sum = nbatches*mean;
+    double autocovariance = lag_products[iseries] - mean*(2*sum - first_values[iseries] - last_values[iseries]) + (nbatches-1)*mean*mean;
+    return std::max(-1.0, std::min(1.0, autocovariance/square_deviations[iseries]));
+}
+
+double ConvergenceMonitor::get_autocorrelation_bound() const {
+    return nbatches>0 ? 1.96/std::sqrt(nbatches) : std::numeric_limits<double>::infinity();
+}
+
+double ConvergenceMonitor::get_half_width(int iseries) const {
+    if (nbatches<2) return std::numeric_limits<double>::infinity();
+    double correlation = std::max(0.0, get_lag1_autocorrelation(iseries));
+    if (correlation>=1) return std::numeric_limits<double>::infinity();
+    return student_t_975(nbatches-1)*std::sqrt(square_deviations[iseries]/(nbatches-1)/nbatches*(1+correlation)/(1-correlation));
+}
+
+double ConvergenceMonitor::get_relative_half_width(int iseries) const {
+    return get_half_width(iseries)/std::max(std::fabs(means[iseries]), min_scale);
+}
+
+int ConvergenceMonitor::get_worst_series() const {
+    int worst = 0;
+    for (int iseries=1; iseries<names.size(); iseries++) {
+        if (get_relative_half_width(iseries)>get_relative_half_width(worst)) worst = iseries;
+    }
+    return worst;
+}
+
+bool ConvergenceMonitor::converged() const {
+    if (nbatches<min_batches) return false;
+    return names.empty() || get_relative_half_width(get_worst_series())<=precision;
+}
+
+double ConvergenceMonitor::student_t_975(int dof) {
+    assert(dof>=1);
+    // tabulated below 10 degrees of freedom, then the Cornish-Fisher expansion around the normal quantile (error < 1e-3)
+    static const double small_dof[10] = {0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262};
+    if (dof<10) return small_dof[dof];
+    double z = 1.959964;
+    double z3 = z*z*z, z5 = z3*z*z, z7 = z5*z*z;
+    double n = dof;
+    return z + (z3+z)/(4*n) + (5*z5+16*z3+3*z)/(96*n*n) + (3*z7+19*z5+17*z3-15*z)/(384*n*n*n);
+}
+
+void ConvergenceMonitor::write_json(std::ostream& os) const {
+    // JSON has no infinity, the half widths of fewer than two batches or of fully correlated ones are null
+    auto write_value = [&](double value) {
+        if (std::isinf(value)) os<<"null";
+        else os<<value;
+    };
+    os<<"{\"precision\": "<<precision<<", \"batches\": "<<nbatches<<", \"min_batches\": "<<min_batches<<", \"converged\": "<<(converged() ? "true" : "false");
+    if (!names.empty()) {
+        int worst = get_worst_series();
+        os<<", \"worst\": \""<<names[worst]<<"\", \"achieved_precision\": ";
+        write_value(get_relative_half_width(worst));
+        // positive correlations beyond the bound tell that the batches are too short for the statistics to be independent
+        int most_correlated = 0;
+        int significant = 0;
+        for (int iseries=0; iseries<names.size(); iseries++) {
+            if (get_lag1_autocorrelation(iseries)>get_lag1_autocorrelation(most_correlated)) most_correlated = iseries;
+            if (get_lag1_autocorrelation(iseries)>get_autocorrelation_bound()) significant++;
+        }
+        os<<", \"max_lag1_autocorrelation\": "<<get_lag1_autocorrelation(most_correlated)<<", \"most_correlated\": \""<<names[most_correlated]<<"\"";
+        os<<", \"significant_autocorrelations\": "<<significant;
+    }
+    os<<", \"autocorrelation_bound\": ";
+    write_value(get_autocorrelation_bound());
+    os<<",\n\"series\": {";
+    for (int iseries=0; iseries<names.size(); iseries++) {
+        os<<(iseries>0 ? ",\n    " : "\n    ")<<"\""<<names[iseries]<<"\": {\"mean\": "<<means[iseries]<<", \"half_width\": ";
+        write_value(get_half_width(iseries));
+        os<<", \"lag1_autocorrelation\": "<<get_lag1_autocorrelation(iseries)<<", \"relative_half_width\": ";
+        write_value(get_relative_half_width(iseries));
+        os<<"}";
+    }
+    os<<"}}";
+}
@@ -23,8 +23,12 @@ OUTPUT_LINKS(output_links) {
 
 void DTCEventBuilder::tick() {
     clock_ticks_counter ++;
-    if (remaining_time_to_send_last_event > 0) remaining_time_to_send_last_event--;
+    if (remaining_time_to_send_last_event > 0) {
+        remaining_time_to_send_last_event--;
+        link_busy_ticks++;
+    }
     if (out_event_ready.get_value()) out_event_ready.set_value(false);
+    int nfull = 0;
     for (int ichip=0; ichip<nchips; ichip++) {
         if (in_data_valid[ichip].get_value() == true) {
             buffer_counter[ichip] += 1;
@@ -48,17 +52,22 @@ void DTCEventBuilder::tick() {
         read_data_last_time[ichip] = read_data_this_time;
         out_read_control[ichip].set_value( (!control_full_event[ichip]) && (!read_control_last_time[ichip]) );
         read_control_last_time[ichip]=( (!control_full_event[ichip]) && (!read_control_last_time[ichip]) ); // avoid consecutive control read, otherwise might read more word than needed due to signal delay.
+        nfull += control_full_event[ichip];
     }
+    if (nfull>0 && nfull<nchips) wait_ticks++;
     //if (ID==0) {
     //    std::cout<<"EB "<<ID<<" is full event status = ";
     //    for (auto i : control_full_event) std::cout<<i;
     //    std::cout<<std::endl;
     //}
-    if (std::all_of(control_full_event.begin(), control_full_event.end(), [](bool v){return v;} ) && std::all_of(words_to_read.begin(), words_to_read.end(), [](int i){return i==0;} ) && (remaining_time_to_send_last_event == 0)) { // if all chips have full data for the event, and the last event has been sent out
+    bool event_complete = (nfull==nchips) && std::all_of(words_to_read.begin(), words_to_read.end(), [](int i){return i==0;} );
+    if (event_complete && (remaining_time_to_send_last_event > 0)) link_blocked_ticks++;
+    if (event_complete && (remaining_time_to_send_last_event == 0)) { // if all chips have full data for the event, and the last event has been sent out
         if (WORD_PER_CLOCK_TICK_TO_SEND_EVENT>0) {
             remaining_time_to_send_last_event = int(std::accumulate(buffer_counter.begin(), buffer_counter.end(), 0)/WORD_PER_CLOCK_TICK_TO_SEND_EVENT);
         }
         out_event_ready.set_value(true);
+        events_built++;
         int maximum_number_of_words = *max_element(buffer_counter.begin(), buffer_counter.end());
         //std::cout<<"New event processed after "<<clock_ticks_counter<<" clock ticks! with maximum number of words per chip = "<<maximum_number_of_words;
         //std::cout<<" Will take "<<remaining_time_to_send_last_event<<" clock ticks to send it out."<<std::endl;
@@ -74,6 +83,73 @@ void DTCEventBuilder::tick() {
     }
 }
 
+// idle when nothing arrives and no data word is expected, either waiting for chips to complete the event
+// or for the output link to finish sending the last one (then the next event is sent when it reaches 0)
+unsigned long long DTCEventBuilder::idle_ticks() {
+    if (out_event_ready.get_value()) return 0;
+    for (int ichip=0; ichip<nchips; ichip++) {
+        if (in_data_valid[ichip].get_value() || in_control_valid[ichip].get_value() || words_to_read[ichip]>0) return 0;
+    }
+    if (std::all_of(control_full_event.begin(), control_full_event.end(), [](bool v){return v;} )) {
+        if (remaining_time_to_send_last_event == 0) return 0;
+        return remaining_time_to_send_last_event - 1;
+    }
+    return std::numeric_limits<unsigned long long>::max();
+}
+
+void DTCEventBuilder::skip_ticks(unsigned long long n) {
+    clock_ticks_counter += n;
+    link_busy_ticks += std::min((unsigned long long) remaining_time_to_send_last_event, n);
+    remaining_time_to_send_last_event -= std::min((unsigned long long) remaining_time_to_send_last_event, n);
+    // nothing arrives while skipping, so the chips waiting for their event (or the complete event waiting for the links) stay so
+    int nfull = std::count(control_full_event.begin(), control_full_event.end(), true);
+    if (nfull>0 && nfull<nchips) wait_ticks += n;
+    if (nfull==nchips) link_blocked_ticks += n;
+    // control reads of chips still waiting for their event alternate every tick
+    if (n%2==1) {
+        for (int ichip=0; ichip<nchips; ichip++) {
+            if (control_full_event[ichip]) continue;
+            read_control_last_time[ichip] = !read_control_last_time[ichip];
+            out_read_control[ichip].set_value( read_control_last_time[ichip] );
+        }
+    }
+}
+
 int DTCEventBuilder::get_ID() {
     return ID;
 }
+
+void DTCEventBuilder::save_state(StateWriter& out) {
+    Component::save_state(out);
+    out.write(words_to_read);
+    out.write(buffer_counter);
+    out.write(control_full_event);
+    out.write(control_new_event_header);
+    out.write(read_control_last_time);
+    out.write(read_data_last_time);
+    out.write(clock_ticks_counter);
+    out.write(processing_new_event);
+    out.write(remaining_time_to_send_last_event);
+    out.write(events_built);
+    out.write(link_busy_ticks);
+    out.write(wait_ticks);
+    out.write(link_blocked_ticks);
+}
+
+void DTCEventBuilder::load_state(StateReader& in) {
+    Component::load_state(in);
+    in.read(words_to_read);
+    in.read(buffer_counter);
+    in.read(control_full_event);
+    in.read(control_new_event_header);
+    in.read(read_control_last_time);
+    in.read(read_data_last_time);
+    assert(words_to_read.size()==nchips && buffer_counter.size()==nchips && control_full_event.size()==nchips);
+    in.read(clock_ticks_counter);
+    in.read(processing_new_event);
+    in.read(remaining_time_to_send_last_event);
+    in.read(events_built);
+    in.read(link_busy_ticks);
+    in.read(wait_ticks);
+    in.read(link_blocked_ticks);
+}
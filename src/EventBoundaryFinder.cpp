@@ -1,5 +1,6 @@
 #include<iostream>
 #include<bitset>
+#include<limits>
 #include<interface/EventBoundaryFinder.h>
 
 EventBoundaryFinder::EventBoundaryFinder(bool _do_parse) : do_parse(_do_parse) {
@@ -12,6 +13,12 @@ EventBoundaryFinder::EventBoundaryFinder(bool _do_parse) : do_parse(_do_parse) {
 };
 
 void EventBoundaryFinder::tick() {
+    if (do_parse) tick_impl<true>();
+    else tick_impl<false>();
+};
+
+template<bool DO_PARSE>
+void EventBoundaryFinder::tick_impl() {
     out_fifo_i1_pop.set_value(false);
     out_fifo_o2_read.set_value(false);
     out_fifo_o1_read.set_value(false);
@@ -31,6 +38,7 @@ void EventBoundaryFinder::tick() {
     }
     if (halt_time>0) {
         halt_time--;
+        halt_ticks++;
         return;
     }
 
@@ -63,7 +71,7 @@ void EventBoundaryFinder::tick() {
         assert(n_boundaries<=5); // unlikely but 5 events with 11 bits each?
         for (uint8_t iboundary=0; iboundary<n_boundaries; iboundary++) {
             // append halt time related to each new event
-            if (do_parse) halt_time += (in_data>>(48-8*iboundary)) & ((uint64_t) 0xff);
+            if (DO_PARSE) halt_time += (in_data>>(48-8*iboundary)) & ((uint64_t) 0xff);
             // for more than 1 event boundary in the same word, duplicate the 
             // data and control words and send later
             if (iboundary>0) {
@@ -83,3 +91,43 @@ void EventBoundaryFinder::tick() {
 
 
 };
+template void EventBoundaryFinder::tick_impl<true>();
+template void EventBoundaryFinder::tick_impl<false>();
+
+
+// idle while halted for parsing, or while waiting for the input FIFO with the pop request already raised
+unsigned long long EventBoundaryFinder::idle_ticks() {
+    if (queued_data_words.size()>0 or in_fifo_i1_data_valid.get_value()) return 0;
+    if (out_fifo_o1_read.get_value() or out_fifo_o2_read.get_value()) return 0;
+    if (out_fifo_o1_data.get_value()!=0 or out_fifo_o2_data.get_value()!=0) return 0;
+    if (halt_time>0) {
+        if (out_fifo_i1_pop.get_value()) return 0;
+        return halt_time;
+    }
+    if (out_fifo_i1_pop.get_value() != in_enable_fifo_i1_data_pop.get_value()) return 0;
+    return std::numeric_limits<unsigned long long>::max();
+};
+
+void EventBoundaryFinder::save_state(StateWriter& out) {
+    Component::save_state(out);
+    out.write(halt_time);
+    out.write(halt_ticks);
+    out.write(queued_data_words);
+    out.write(queued_control_words);
+};
+
+void EventBoundaryFinder::load_state(StateReader& in) {
+    Component::load_state(in);
+    in.read(halt_time);
+    in.read(halt_ticks);
+    in.read(queued_data_words);
+    in.read(queued_control_words);
+};
+
+void EventBoundaryFinder::skip_ticks(unsigned long long n) {
+    if (halt_time>0) {
+        assert(n<=halt_time);
+        halt_time -= n;
+        halt_ticks += n;
+    }
+};
@@ -0,0 +1,32 @@
+#include <interface/EventChunkStream.h>
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+EventChunkStream::EventChunkStream(std::shared_ptr<EventChunkSource> _source, int _chunk_events) :
+    source(_source), chunk_events(std::min(_chunk_events, _source->get_nevents()))
+    {
+    assert(chunk_events>0);
+    prefetch();
+}
+
+EventChunkStream::~EventChunkStream() {
+    if (prefetched_chunk.valid()) prefetched_chunk.wait();
+}
+
+void EventChunkStream::prefetch() {
+    int first_event = next_first_event;
+    int nevents = std::min(chunk_events, source->get_nevents() - first_event);
+    next_first_event = (first_event + nevents) % source->get_nevents();
+    // the source is only read by one prefetch at a time
+    prefetched_chunk = std::async(std::launch::async, [this, first_event, nevents]() {
+        return source->read_chunk(first_event, nevents);
+    });
+}
+
+std::shared_ptr<const EventChipMatrix> EventChunkStream::next_chunk() {
+    std::shared_ptr<const EventChipMatrix> chunk = prefetched_chunk.get();
+    prefetch();
+    return chunk;
+}
@@ -0,0 +1,319 @@
+#include <interface/EventLevelEngine.h>
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+using namespace std;
+
+EventLevelEngine::EventLevelEngine(std::shared_ptr<ChipDataPlayer> _player, const std::vector<int>& eb_assignment, int _neb, bool _do_parse, int _output_links) :
+    player(_player), neb(_neb), do_parse(_do_parse), output_links(_output_links), chips(eb_assignment.size()), builders(_neb),
+    sum_series(size_t(OCCUPANCY_NFIFOS)*(_neb+1)), sum_deltas(size_t(OCCUPANCY_NFIFOS)*(_neb+1)*window_ticks, 0),
+    sum_changed(size_t(OCCUPANCY_NFIFOS)*(_neb+1)*window_ticks/64, 0)
+    {
+    assert(player->is_random_l1());
+    for (int ichip=0; ichip<chips.size(); ichip++) {
+        int ieb = eb_assignment[ichip];
+        assert(ieb>=0 && ieb<neb);
+        chips[ichip].eb = ieb;
+        chips[ichip].index_in_eb = builders[ieb].chips.size();
+        builders[ieb].chips.push_back(ichip);
+    }
+    for (int ififo=0; ififo<OCCUPANCY_NFIFOS; ififo++) {
+        for (int ieb=0; ieb<neb; ieb++) histograms[ififo].emplace_back(builders[ieb].chips.size());
+    }
+}
+
+unsigned long long EventLevelEngine::run(int nevents) {
+    unsigned long long window_start = 0;
+    while (true) {
+        unsigned long long window_end = window_start + window_ticks;
+        advance_player(window_end);
+        for (Chip& chip : chips) advance_input(chip, window_end);
+        bool done = true;
+        unsigned long long nticks = 0;
+        for (Builder& builder : builders) {
+            builder.window_completions.clear();
+            advance_builder(builder, window_end, nevents);
+            if (builder.events_built<nevents) done = false;
+            else nticks = std::max(nticks, builder.last_event_tick+1);
+        }
+        if (!done) {
+            flush(window_start, window_end);
+            window_start = window_end;
+            continue;
+        }
+        // the tick loop stops right after the tick on which the last event builder built its nevents-th event
+        flush(window_start, nticks);
+        for (Builder& builder : builders) {
+            for (unsigned long long completion : builder.window_completions) if (completion>=nticks) builder.events_built--;
+        }
+        for (Chip& chip : chips) {
+            for (int ififo=0; ififo<OCCUPANCY_NFIFOS; ififo++) {
+                LaneChanges& lane = chip.changes[ififo];
+                if (nticks>lane.last_tick) histograms[ififo][chip.eb].add(chip.index_in_eb, lane.occupancy, nticks-lane.last_tick);
+            }
+        }
+        for (int iseries=0; iseries<sum_series.size(); iseries++) {
+            if (nticks>sum_series[iseries].last_tick) add_to_sum(iseries, sum_series[iseries].value, nticks-sum_series[iseries].last_tick);
+        }
+        return nticks;
+    }
+}
+
+// the words the chips send on the ticks before end, the input FIFOs push them on the next tick
+void EventLevelEngine::advance_player(unsigned long long end) {
+    while (player_tick<end) {
+        unsigned long long n = player->idle_ticks();
+        if (n>0) {
+            n = std::min(n, end-player_tick);
+            player->skip_ticks(n);
+            player_tick += n;
+            continue;
+        }
+        player->tick();
+        for (int ichip : player->get_chips_sent()) chips[ichip].input.emplace_back(player_tick+1, player->out_data[ichip].get_value());
+        player_tick++;
+    }
+}
+
+void EventLevelEngine::push_output(Chip& chip, unsigned long long tick, bool header) {
+    chip.output.push_back({tick, header});
+    chip.changes[OCCUPANCY_FIFO_OUTPUT_DATA].pushes.push_back(tick);
+}
+
+// the input FIFO (as FIFOBank) and the EventBoundaryFinder of a chip on the ticks before end
+void EventLevelEngine::advance_input(Chip& chip, unsigned long long end) {
+    unsigned long long& t = chip.tick;
+    LaneChanges& changes = chip.changes[OCCUPANCY_FIFO_INPUT];
+    while (t<end) {
+        unsigned long long next_arrival = chip.n_arrived<chip.input.size() ? chip.input[chip.n_arrived].first : std::numeric_limits<unsigned long long>::max();
+        bool fifo_pop = chip.pop && chip.n_arrived>0;
+        // nothing read nor forwarded until the next word arrives: halted, or waiting for the empty FIFO
+        if (!chip.in_valid && chip.queued_words==0 && !fifo_pop && next_arrival>t) {
+            if (chip.halt_time>0) {
+                unsigned long long n = std::min({(unsigned long long) chip.halt_time, next_arrival-t, end-t});
+                chip.halt_time -= n;
+                chip.pop = false;
+                t += n;
+                continue;
+            }
+            if (chip.n_arrived==0) {
+                chip.pop = true;
+                t = std::min(next_arrival, end);
+                continue;
+            }
+        }
+        // input FIFO, pop before push
+        bool popped = false;
+        uint64_t popped_data = 0;
+        if (fifo_pop) {
+            popped_data = chip.input.front().second;
+            chip.input.pop_front();
+            chip.n_arrived--;
+            changes.pops.push_back(t);
+            popped = true;
+        }
+        if (next_arrival==t) {
+            chip.n_arrived++;
+            changes.pushes.push_back(t);
+        }
+        // boundary finder, a word read while it sends queued words or is halted is lost as in EventBoundaryFinder
+        if (chip.queued_words>0) {
+            push_output(chip, t+1, true);
+            chip.queued_words--;
+            chip.pop = false;
+        }
+        else if (chip.halt_time>0) {
+            chip.halt_time--;
+            chip.pop = false;
+        }
+        else {
+            chip.pop = true;
+            if (chip.in_valid) {
+                bool header = chip.in_data & (((uint64_t)1)<<63);
+                push_output(chip, t+1, header);
+                if (header) {
+                    int n_boundaries = (chip.in_data>>56) & 0x7f;
+                    assert(n_boundaries<=5);
+                    for (int iboundary=0; iboundary<n_boundaries; iboundary++) {
+                        if (do_parse) chip.halt_time += (chip.in_data>>(48-8*iboundary)) & ((uint64_t) 0xff);
+                        if (iboundary>0) chip.queued_words++;
+                    }
+                    chip.pop = false;
+                }
+            }
+        }
+        chip.in_valid = popped;
+        chip.in_data = popped_data;
+        t++;
+    }
+}
+
+// the output FIFOs of a chip and its part of the DTCEventBuilder tick, on the ticks before end or until the chip is settled
+bool EventLevelEngine::advance_output(Chip& chip, unsigned long long end) {
+    if (chip.settled) return true;
+    unsigned long long& t = chip.eb_tick;
+    LaneChanges& changes = chip.changes[OCCUPANCY_FIFO_OUTPUT_DATA];
+    while (t<end) {
+        // only the control read request toggles until the next control word can be read
+        if (!chip.data_valid && !chip.control_valid && chip.words_to_read==0 && !chip.full_event) {
+            unsigned long long next = end;
+            if (chip.control_popped < chip.output_base+chip.output.size()) {
+                next = std::max(t, chip.output[chip.control_popped-chip.output_base].push_tick+1);
+                // popped on the tick after the one with the read request
+                if (chip.read_control == bool((next-t)&1)) next++;
+                next = std::min(next, end);
+            }
+            if (next>t) {
+                chip.read_control ^= bool((next-t)&1);
+                t = next;
+                continue;
+            }
+        }
+        // output FIFOs, pop before push
+        bool popped_data = false;
+        bool popped_control = false;
+        bool popped_header = false;
+        if (chip.read_control && chip.control_popped < chip.output_base+chip.output.size()) {
+            const OutputWord& word = chip.output[chip.control_popped-chip.output_base];
+            if (word.push_tick<t) {
+                popped_header = word.header;
+                chip.control_popped++;
+                popped_control = true;
+            }
+        }
+        if (chip.read_data && chip.data_popped < chip.output_base+chip.output.size()) {
+            if (chip.output[chip.data_popped-chip.output_base].push_tick<t) {
+                chip.data_popped++;
+                changes.pops.push_back(t);
+                popped_data = true;
+            }
+        }
+        while (chip.output_base < std::min(chip.data_popped, chip.control_popped)) {
+            chip.output.pop_front();
+            chip.output_base++;
+        }
+        // event builder
+        if (chip.data_valid) {
+            chip.buffer_counter++;
+            chip.words_to_read--;
+            assert(chip.words_to_read>=0);
+        }
+        if (chip.control_valid) {
+            assert(!chip.full_event);
+            if (chip.control_header && chip.buffer_counter>0) {
+                chip.full_event = true;
+                chip.new_event_header = true;
+            }
+            else {
+                chip.words_to_read++;
+            }
+        }
+        chip.read_data = (chip.words_to_read>1) || (chip.words_to_read==1 && !chip.read_data);
+        chip.read_control = !chip.full_event && !chip.read_control;
+        chip.data_valid = popped_data;
+        chip.control_valid = popped_control;
+        chip.control_header = popped_header;
+        t++;
+        if (chip.full_event && chip.words_to_read==0) {
+            assert(!chip.data_valid && !chip.control_valid);
+            chip.settled = true;
+            chip.settled_tick = t-1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// events completed on the ticks before end
+void EventLevelEngine::advance_builder(Builder& builder, unsigned long long end, int nevents) {
+    while (true) {
+        bool all_settled = true;
+        for (int ichip : builder.chips) all_settled = advance_output(chips[ichip], end) && all_settled;
+        if (!all_settled) return;
+        unsigned long long completion = builder.earliest_completion;
+        int total_words = 0;
+        for (int ichip : builder.chips) {
+            completion = std::max(completion, chips[ichip].settled_tick);
+            total_words += chips[ichip].buffer_counter;
+        }
+        if (completion>=end) return;
+        builder.events_built++;
+        builder.window_completions.push_back(completion);
+        if (builder.events_built==nevents) builder.last_event_tick = completion;
+        unsigned long long remaining_time = output_links>0 ? total_words/output_links : 0;
+        builder.earliest_completion = completion + std::max(remaining_time, 1ull);
+        for (int ichip : builder.chips) {
+            Chip& chip = chips[ichip];
+            chip.full_event = false;
+            chip.buffer_counter = 0;
+            if (chip.new_event_header) {
+                chip.new_event_header = false;
+                chip.words_to_read++;
+            }
+            chip.read_data = false;
+            chip.read_control = false;
+            chip.settled = false;
+            chip.eb_tick = completion+1;
+        }
+    }
+}
+
+void EventLevelEngine::flush(unsigned long long window_start, unsigned long long end) {
+    for (Chip& chip : chips) {
+        for (int ififo=0; ififo<OCCUPANCY_NFIFOS; ififo++) flush_lane(chip.changes[ififo], ififo, chip, window_start, end);
+    }
+    // only the ticks with a change are visited, the sums are constant in between
+    for (int iseries=0; iseries<sum_series.size(); iseries++) {
+        SumSeries& series = sum_series[iseries];
+        int32_t* deltas = sum_deltas.data() + size_t(iseries)*window_ticks;
+        uint64_t* changed = sum_changed.data() + size_t(iseries)*window_ticks/64;
+        for (int iword=0; iword<window_ticks/64; iword++) {
+            while (changed[iword]) {
+                int i = iword*64 + __builtin_ctzll(changed[iword]);
+                changed[iword] &= changed[iword]-1;
+                if (deltas[i]==0) continue;
+                unsigned long long t = window_start + i;
+                if (t>series.last_tick) add_to_sum(iseries, series.value, t-series.last_tick);
+                series.value += deltas[i];
+                series.last_tick = t;
+                deltas[i] = 0;
+            }
+        }
+    }
+}
+
+void EventLevelEngine::flush_lane(LaneChanges& lane, int ififo, const Chip& chip, unsigned long long window_start, unsigned long long end) {
+    size_t eb_series = size_t(ififo)*(neb+1) + chip.eb;
+    size_t total_series = size_t(ififo)*(neb+1) + neb;
+    size_t ipush = 0;
+    size_t ipop = 0;
+    while (true) {
+        unsigned long long push_tick = ipush<lane.pushes.size() ? lane.pushes[ipush] : std::numeric_limits<unsigned long long>::max();
+        unsigned long long pop_tick = ipop<lane.pops.size() ? lane.pops[ipop] : std::numeric_limits<unsigned long long>::max();
+        unsigned long long t = std::min(push_tick, pop_tick);
+        if (t>=end) break;
+        assert(t>=window_start);
+        if (t>lane.last_tick) {
+            histograms[ififo][chip.eb].add(chip.index_in_eb, lane.occupancy, t-lane.last_tick);
+            lane.last_tick = t;
+        }
+        int delta = (push_tick==t) ? 1 : -1;
+        if (push_tick==t) ipush++;
+        else ipop++;
+        lane.occupancy += delta;
+        for (size_t iseries : {eb_series, total_series}) {
+            sum_deltas[iseries*window_ticks + (t-window_start)] += delta;
+            sum_changed[(iseries*window_ticks + (t-window_start))/64] |= 1ull<<((t-window_start)%64);
+        }
+    }
+    lane.pushes.erase(lane.pushes.begin(), lane.pushes.begin()+ipush);
+    lane.pops.erase(lane.pops.begin(), lane.pops.begin()+ipop);
+}
+
+void EventLevelEngine::add_to_sum(int iseries, uint32_t value, unsigned long long n) {
+    int ififo = iseries/(neb+1);
+    int ieb = iseries%(neb+1);
+    if (ieb<neb) histograms[ififo][ieb].add_sum(value, n);
+    else total_histograms[ififo].add(value, n);
+}
@@ -0,0 +1,160 @@
+#include <interface/EventSizeCache.h>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+constexpr char EventSizeCache::magic[8];
+
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + EventChipMatrix::alignment - 1) / EventChipMatrix::alignment * EventChipMatrix::alignment;
+}
+
+EventSizeCache::EventSizeCache(std::string cache_file_name) {
+    int fd = open(cache_file_name.c_str(), O_RDONLY);
+    if (fd<0) throw std::runtime_error("Unable to open "+cache_file_name);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat)!=0 || size_t(file_stat.st_size)<sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Invalid event size cache "+cache_file_name);
+    }
+    mapping_bytes = file_stat.st_size;
+    // private writable mapping, so the matrices can be handed out as EventChipMatrix without copying
+    void* addr = mmap(nullptr, mapping_bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr==MAP_FAILED) throw std::runtime_error("Unable to map "+cache_file_name);
+    size_t bytes = mapping_bytes;
+    mapping.reset(static_cast<char*>(addr), [bytes](char* p) {munmap(p, bytes);});
+    const Header* header = reinterpret_cast<const Header*>(mapping.get());
+    if (std::memcmp(header->magic, magic, sizeof(magic))!=0) throw std::runtime_error(cache_file_name+" is not an event size cache");
+    if (header->version!=version) throw std::runtime_error(cache_file_name+" has cache version "+to_string(header->version)+", expected "+to_string(version)+", convert the input again");
+    if (header->file_bytes!=mapping_bytes) throw std::runtime_error(cache_file_name+" is truncated");
+}
+
+const EventSizeCache::DTCEntry* EventSizeCache::find_dtc(std::string dtcname) {
+    const Header* header = reinterpret_cast<const Header*>(mapping.get());
+    const DTCEntry* entries = reinterpret_cast<const DTCEntry*>(mapping.get() + sizeof(Header));
+    for (uint32_t idtc=0; idtc<header->ndtcs; idtc++) {
+        if (std::strncmp(entries[idtc].name, dtcname.c_str(), sizeof(entries[idtc].name))==0) return &entries[idtc];
+    }
+    return nullptr;
+}
+
+bool EventSizeCache::has_dtc(std::string dtcname) {
+    return find_dtc(dtcname)!=nullptr;
+}
+
+void EventSizeCache::stat_source(std::string source_file_name, uint64_t& bytes, int64_t& mtime_ns) {
+    struct stat file_stat;
+    if (stat(source_file_name.c_str(), &file_stat)!=0) throw std::runtime_error("Unable to read "+source_file_name);
+    bytes = file_stat.st_size;
+    mtime_ns = int64_t(file_stat.st_mtim.tv_sec)*1000000000 + file_stat.st_mtim.tv_nsec;
+}
+
+bool EventSizeCache::is_stale(std::string source_file_name) {
+    const Header* header = reinterpret_cast<const Header*>(mapping.get());
+    uint64_t bytes;
+    int64_t mtime_ns;
+    stat_source(source_file_name, bytes, mtime_ns);
+    return bytes!=header->source_bytes || mtime_ns!=header->source_mtime_ns;
+}
+
+DTCInput EventSizeCache::load(std::string dtcname) {
+    const DTCEntry* entry = find_dtc(dtcname);
+    if (!entry) throw std::runtime_error("DTC "+dtcname+" is not in the event size cache");
+    DTCInput input;
+    const ChipInfo* chips = reinterpret_cast<const ChipInfo*>(mapping.get() + entry->chips_offset);
+    input.chips.assign(chips, chips + entry->nchips);
+    // the matrix shares the ownership of the mapping
+    std::shared_ptr<EventChipMatrix::Entry> matrix_entries(mapping, reinterpret_cast<EventChipMatrix::Entry*>(mapping.get() + entry->matrix_offset));
+    input.event_chip_matrix = std::make_shared<EventChipMatrix>(entry->nevents, entry->nchips, entry->row_stride, matrix_entries);
+    return input;
+}
+
+// Chunks of a mapped DTC matrix, used in place. Reading a chunk asks the kernel to page it in,
+// the pages of chunks no longer in use are released.
+class CachedChunkSource : public EventChunkSource {
+    public:
+        CachedChunkSource(DTCInput _input) : input(_input) {};
+        int get_nevents() override {return input.event_chip_matrix->get_nevents();}
+        const std::vector<ChipInfo>& get_chips() override {return input.chips;}
+        std::shared_ptr<EventChipMatrix> read_chunk(int first_event, int chunk_events) override {
+            const EventChipMatrix& matrix = *input.event_chip_matrix;
+            EventChipMatrix::Entry* first_row = const_cast<EventChipMatrix::Entry*>(matrix.row(first_event));
+            size_t chunk_bytes = size_t(chunk_events) * matrix.get_row_stride() * sizeof(EventChipMatrix::Entry);
+            advise(first_row, chunk_bytes, MADV_WILLNEED);
+            // the chunk keeps the mapping alive, and drops its pages once the player is done with it
+            std::shared_ptr<EventChipMatrix::Entry> entries(first_row, [mapping=input.event_chip_matrix, chunk_bytes](EventChipMatrix::Entry* p) {
+                advise(p, chunk_bytes, MADV_DONTNEED);
+            });
+            return std::make_shared<EventChipMatrix>(chunk_events, matrix.get_nchips(), matrix.get_row_stride(), entries);
+        }
+    private:
+        // madvise on the whole pages inside [p, p+bytes)
+        static void advise(void* p, size_t bytes, int advice) {
+            uintptr_t page = sysconf(_SC_PAGESIZE);
+            uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + page - 1) / page * page;
+            uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) / page * page;
+            if (end>begin) madvise(reinterpret_cast<void*>(begin), end-begin, advice);
+        }
+        DTCInput input;
+};
+
+std::shared_ptr<EventChunkSource> EventSizeCache::open_stream(std::string dtcname) {
+    return std::make_shared<CachedChunkSource>(load(dtcname));
+}
+
+void EventSizeCache::write(std::string cache_file_name, std::string source_file_name, const std::vector<std::string>& dtcnames, std::function<DTCInput(std::string)> read_dtc) {
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.ndtcs = dtcnames.size();
+    // taken before reading, a source rewritten during the conversion leaves the cache stale
+    if (!source_file_name.empty()) stat_source(source_file_name, header.source_bytes, header.source_mtime_ns);
+    std::vector<DTCEntry> entries(dtcnames.size());
+    std::memset(entries.data(), 0, sizeof(DTCEntry)*entries.size());
+
+    std::ofstream os(cache_file_name, std::ios::binary);
+    if (!os) throw std::runtime_error("Unable to write to "+cache_file_name);
+    const std::vector<char> zeros(EventChipMatrix::alignment, 0);
+    auto pad_to = [&](uint64_t target) {
+        uint64_t position = os.tellp();
+        assert(target>=position && target-position<=zeros.size());
+        os.write(zeros.data(), target-position);
+    };
+    // the header and the DTC table are rewritten once all offsets are known
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(entries.data()), sizeof(DTCEntry)*entries.size());
+    uint64_t offset = align_offset(sizeof(Header) + sizeof(DTCEntry)*entries.size());
+    for (size_t idtc=0; idtc<dtcnames.size(); idtc++) {
+        DTCEntry& entry = entries[idtc];
+        if (dtcnames[idtc].size()>=sizeof(entry.name)) throw std::runtime_error("DTC name too long for the event size cache: "+dtcnames[idtc]);
+        std::strncpy(entry.name, dtcnames[idtc].c_str(), sizeof(entry.name)-1);
+        DTCInput input = read_dtc(dtcnames[idtc]);
+        const EventChipMatrix& matrix = *input.event_chip_matrix;
+        assert(input.chips.size()==size_t(matrix.get_nchips()));
+        entry.nchips = matrix.get_nchips();
+        entry.nevents = matrix.get_nevents();
+        entry.row_stride = matrix.get_row_stride();
+        entry.chips_offset = offset;
+        entry.matrix_offset = align_offset(entry.chips_offset + sizeof(ChipInfo)*entry.nchips);
+        offset = align_offset(entry.matrix_offset + matrix.get_bytes());
+        pad_to(entry.chips_offset);
+        os.write(reinterpret_cast<const char*>(input.chips.data()), sizeof(ChipInfo)*entry.nchips);
+        pad_to(entry.matrix_offset);
+        os.write(reinterpret_cast<const char*>(matrix.row(0)), matrix.get_bytes());
+    }
+    pad_to(offset);
+    header.file_bytes = offset;
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(entries.data()), sizeof(DTCEntry)*entries.size());
+    if (!os) throw std::runtime_error("Unable to write to "+cache_file_name);
+}
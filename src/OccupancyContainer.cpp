@@ -0,0 +1,210 @@
+#include <interface/OccupancyContainer.h>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+constexpr char OccupancyContainer::magic[8];
+
+OccupancyContainer::OccupancyContainer(std::string file_name) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd<0) throw std::runtime_error("Unable to open "+file_name);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat)!=0 || size_t(file_stat.st_size)<sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Invalid occupancy container "+file_name);
+    }
+    size_t bytes = file_stat.st_size;
+    void* addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr==MAP_FAILED) throw std::runtime_error("Unable to map "+file_name);
+    mapping.reset(static_cast<char*>(addr), [bytes](char* p) {munmap(p, bytes);});
+    header = reinterpret_cast<const Header*>(mapping.get());
+    if (std::memcmp(header->magic, magic, sizeof(magic))!=0) throw std::runtime_error(file_name+" is not an occupancy container");
+    if (header->version!=version) throw std::runtime_error(file_name+" has container version "+to_string(header->version)+", expected "+to_string(version));
+    if (header->file_bytes!=bytes) throw std::runtime_error(file_name+" is truncated");
+    if (header->nfifos!=OCCUPANCY_NFIFOS) throw std::runtime_error(file_name+" has "+to_string(header->nfifos)+" FIFOs per chip");
+    chip_records = reinterpret_cast<const ChipRecord*>(mapping.get() + header->chips_offset);
+    chunk_entries = reinterpret_cast<const ChunkEntry*>(mapping.get() + header->chunks_offset);
+    column_entries = reinterpret_cast<const ColumnEntry*>(mapping.get() + header->columns_offset);
+}
+
+OccupancyContainer::Column OccupancyContainer::column(unsigned long long ichunk, int ififo, int ichip) const {
+    assert(ichunk<header->nchunks && ififo<OCCUPANCY_NFIFOS && ichip<int(header->nchips));
+    const ColumnEntry& entry = column_entries[(ichunk*header->nfifos + ififo)*header->nchips + ichip];
+    const uint32_t* tick_offsets = reinterpret_cast<const uint32_t*>(mapping.get() + entry.offset);
+    return Column{chunk_entries[ichunk].first_tick, entry.nchanges, tick_offsets, reinterpret_cast<const uint16_t*>(tick_offsets + entry.nchanges)};
+}
+
+unsigned long long OccupancyContainer::find_chunk(unsigned long long tick) const {
+    // chunks are contiguous, the last one whose first tick is not after tick
+    const ChunkEntry* end = chunk_entries + header->nchunks;
+    const ChunkEntry* found = std::upper_bound(chunk_entries, end, tick, [](unsigned long long t, const ChunkEntry& chunk) {return t<chunk.first_tick;});
+    return found==chunk_entries ? 0 : found - chunk_entries - 1;
+}
+
+void OccupancyContainer::read(int ififo, int ichip, unsigned long long first_tick, unsigned long long last_tick,
+        std::vector<unsigned long long>& ticks, std::vector<uint16_t>& values) const {
+    ticks.clear();
+    values.clear();
+    last_tick = std::min(last_tick, (unsigned long long) header->total_ticks);
+    if (first_tick>=last_tick) return;
+    for (unsigned long long ichunk=find_chunk(first_tick); ichunk<header->nchunks && chunk_entries[ichunk].first_tick<last_tick; ichunk++) {
+        Column col = column(ichunk, ififo, ichip);
+        for (uint32_t ichange=0; ichange<col.nchanges; ichange++) {
+            unsigned long long tick = col.first_tick + col.tick_offsets[ichange];
+            if (tick>=last_tick) break;
+            // the value at first_tick is the last change before it
+            if (tick<=first_tick) {
+                if (ticks.empty()) {
+                    ticks.push_back(first_tick);
+                    values.push_back(col.values[ichange]);
+                }
+                else values.back() = col.values[ichange];
+                continue;
+            }
+            if (col.values[ichange]==values.back()) continue; // repeated at the start of a chunk
+            ticks.push_back(tick);
+            values.push_back(col.values[ichange]);
+        }
+    }
+}
+
+OccupancyContainerWriter::OccupancyContainerWriter(std::string _file_name, const std::vector<ChipInfo>& chips, const std::vector<int>& eb_assignment, int neb, bool resume) :
+    file_name(_file_name), stream_buffer(stream_buffer_size), nchips(chips.size()), ncolumns(OCCUPANCY_NFIFOS*chips.size()),
+    last_values(ncolumns, 0), column_tick_offsets(ncolumns), column_values(ncolumns) {
+    assert(eb_assignment.size()==chips.size());
+    // the buffer has to be set before the file is opened
+    os.rdbuf()->pubsetbuf(stream_buffer.data(), stream_buffer.size());
+    // the header and chip records written again are the same as in the file being resumed
+    if (resume) os.open(file_name, std::ios::binary | std::ios::in | std::ios::out);
+    else os.open(file_name, std::ios::binary);
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, OccupancyContainer::magic, sizeof(header.magic));
+    header.version = OccupancyContainer::version;
+    header.nchips = nchips;
+    header.nfifos = OCCUPANCY_NFIFOS;
+    header.neb = neb;
+    header.chips_offset = sizeof(header);
+    // the header is rewritten once all offsets are known
+    put(&header, 1);
+    std::vector<OccupancyContainer::ChipRecord> records(nchips);
+    std::memset(records.data(), 0, sizeof(OccupancyContainer::ChipRecord)*records.size());
+    std::vector<int> nchips_per_eb(neb, 0);
+    for (int ichip=0; ichip<nchips; ichip++) {
+        records[ichip].info = chips[ichip];
+        records[ichip].eb = eb_assignment[ichip];
+        records[ichip].index_in_eb = nchips_per_eb[eb_assignment[ichip]]++;
+        std::strncpy(records[ichip].basename, chips[ichip].basename().c_str(), sizeof(records[ichip].basename)-1);
+    }
+    put(records.data(), records.size());
+    pad_to_multiple(64);
+}
+
+OccupancyContainerWriter::~OccupancyContainerWriter() {
+    close();
+}
+
+void OccupancyContainerWriter::pad_to_multiple(uint64_t alignment) {
+    static const char zeros[64] = {0};
+    uint64_t position = os.tellp();
+    uint64_t padding = (alignment - position % alignment) % alignment;
+    assert(padding<=sizeof(zeros));
+    os.write(zeros, padding);
+}
+
+void OccupancyContainerWriter::record(const uint16_t* values, unsigned long long n) {
+    while (n>0) {
+        uint32_t ticks = (uint32_t) std::min(n, (unsigned long long) (max_chunk_ticks - chunk_ticks));
+        for (int icolumn=0; icolumn<ncolumns; icolumn++) {
+            if (values[icolumn]==last_values[icolumn] && chunk_ticks>0) continue;
+            column_tick_offsets[icolumn].push_back(chunk_ticks);
+            column_values[icolumn].push_back(values[icolumn]);
+            last_values[icolumn] = values[icolumn];
+            chunk_changes++;
+        }
+        chunk_ticks += ticks;
+        total_ticks += ticks;
+        n -= ticks;
+        if (chunk_ticks==max_chunk_ticks || chunk_changes>=max_chunk_changes) flush_chunk();
+    }
+}
+
+void OccupancyContainerWriter::flush_chunk() {
+    chunks.push_back(OccupancyContainer::ChunkEntry{total_ticks - chunk_ticks, chunk_ticks});
+    for (int icolumn=0; icolumn<ncolumns; icolumn++) {
+        pad_to_multiple(8);
+        columns.push_back(OccupancyContainer::ColumnEntry{(uint64_t) os.tellp(), (uint32_t) column_values[icolumn].size(), 0});
+        put(column_tick_offsets[icolumn].data(), column_tick_offsets[icolumn].size());
+        put(column_values[icolumn].data(), column_values[icolumn].size());
+        column_tick_offsets[icolumn].clear();
+        column_values[icolumn].clear();
+    }
+    chunk_ticks = 0;
+    chunk_changes = 0;
+}
+
+void OccupancyContainerWriter::save_state(StateWriter& out) {
+    os.flush();
+    out.write<uint64_t>(os.tellp());
+    out.write(total_ticks);
+    out.write(last_values);
+    out.write(chunk_ticks);
+    out.write<uint64_t>(chunk_changes);
+    for (int icolumn=0; icolumn<ncolumns; icolumn++) {
+        out.write(column_tick_offsets[icolumn]);
+        out.write(column_values[icolumn]);
+    }
+    out.write(chunks);
+    out.write(columns);
+}
+
+void OccupancyContainerWriter::load_state(StateReader& in) {
+    uint64_t file_bytes = in.read<uint64_t>();
+    in.read(total_ticks);
+    in.read(last_values);
+    in.read(chunk_ticks);
+    chunk_changes = in.read<uint64_t>();
+    for (int icolumn=0; icolumn<ncolumns; icolumn++) {
+        in.read(column_tick_offsets[icolumn]);
+        in.read(column_values[icolumn]);
+    }
+    in.read(chunks);
+    in.read(columns);
+    if (last_values.size()!=size_t(ncolumns)) throw std::runtime_error("checkpoint of an occupancy container with other columns");
+    // the chunks written after the checkpoint are dropped, the container is written on from the checkpoint
+    os.close();
+    struct stat file_stat;
+    if (stat(file_name.c_str(), &file_stat)!=0 || uint64_t(file_stat.st_size)<file_bytes) throw std::runtime_error(file_name+" is shorter than at the checkpoint");
+    if (truncate(file_name.c_str(), file_bytes)!=0) throw std::runtime_error("Unable to truncate "+file_name);
+    os.clear();
+    os.rdbuf()->pubsetbuf(stream_buffer.data(), stream_buffer.size());
+    os.open(file_name, std::ios::binary | std::ios::in | std::ios::out);
+    os.seekp(file_bytes);
+    if (!os) throw std::runtime_error("Unable to write to "+file_name);
+}
+
+void OccupancyContainerWriter::close() {
+    if (closed) return;
+    closed = true;
+    if (chunk_ticks>0) flush_chunk();
+    pad_to_multiple(64);
+    header.chunks_offset = os.tellp();
+    put(chunks.data(), chunks.size());
+    pad_to_multiple(64);
+    header.columns_offset = os.tellp();
+    put(columns.data(), columns.size());
+    pad_to_multiple(64);
+    header.total_ticks = total_ticks;
+    header.nchunks = chunks.size();
+    header.file_bytes = os.tellp();
+    os.seekp(0);
+    put(&header, 1);
+    os.close();
+}
@@ -0,0 +1,104 @@
+#include <interface/OccupancyHistogram.h>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+unsigned long long OccupancyHistogram::get_entries() const {
+    return std::accumulate(counts.begin(), counts.end(), 0ull);
+}
+
+double OccupancyHistogram::get_mean() const {
+    unsigned long long entries = get_entries();
+    if (entries==0) return 0;
+    double sum = 0;
+    for (size_t value=0; value<counts.size(); value++) sum += 1.0*value*counts[value];
+    return sum/entries;
+}
+
+uint32_t OccupancyHistogram::get_max() const {
+    size_t nbins = counts.size();
+    while (nbins>0 && counts[nbins-1]==0) nbins--;
+    return nbins>0 ? nbins-1 : 0;
+}
+
+uint32_t OccupancyHistogram::quantile(double q) const {
+    unsigned long long entries = get_entries();
+    unsigned long long cumulative = 0;
+    for (size_t value=0; value<counts.size(); value++) {
+        cumulative += counts[value];
+        if (cumulative>0 && cumulative >= q*entries) return value;
+    }
+    return 0;
+}
+
+double OccupancyHistogram::distance(const OccupancyHistogram& other) const {
+    unsigned long long entries = get_entries();
+    unsigned long long other_entries = other.get_entries();
+    if (entries==0 || other_entries==0) return (entries==other_entries) ? 0 : 1;
+    unsigned long long cumulative = 0, other_cumulative = 0;
+    double max_difference = 0;
+    for (size_t value=0; value<std::max(counts.size(), other.counts.size()); value++) {
+        if (value<counts.size()) cumulative += counts[value];
+        if (value<other.counts.size()) other_cumulative += other.counts[value];
+        max_difference = std::max(max_difference, std::abs(1.0*cumulative/entries - 1.0*other_cumulative/other_entries));
+    }
+    return max_difference;
+}
+
+void OccupancyHistogram::write_json(std::ostream& os) const {
+    size_t nbins = counts.size();
+    while (nbins>0 && counts[nbins-1]==0) nbins--;
+    os<<"{\"entries\": "<<get_entries()<<", \"mean\": "<<get_mean()<<", \"max\": "<<(nbins>0 ? nbins-1 : 0);
+    os<<", \"p50\": "<<quantile(0.5)<<", \"p90\": "<<quantile(0.9)<<", \"p99\": "<<quantile(0.99)<<", \"p999\": "<<quantile(0.999)<<", \"p9999\": "<<quantile(0.9999);
+    os<<", \"counts\": [";
+    for (size_t value=0; value<nbins; value++) {
+        if (value>0) os<<", ";
+        os<<counts[value];
+    }
+    os<<"]}";
+}
+
+OccupancyHistogram LaneOccupancyHistograms::lane_histogram(int ilane) const {
+    OccupancyHistogram histogram;
+    for (uint32_t value=0; value<nbins; value++) {
+        unsigned long long n = counts[size_t(ilane)*nbins + value];
+        if (n>0) histogram.add(value, n);
+    }
+    return histogram;
+}
+
+uint32_t LaneOccupancyHistograms::get_max_lane_occupancy() const {
+    for (uint32_t value=nbins; value>0; value--) {
+        for (int ilane=0; ilane<nlanes; ilane++) {
+            if (counts[size_t(ilane)*nbins + value-1]>0) return value-1;
+        }
+    }
+    return 0;
+}
+
+uint32_t LaneOccupancyHistograms::lane_quantile_since(int ilane, double q, const LaneOccupancyHistograms& earlier) const {
+    assert(earlier.nlanes==nlanes && earlier.nbins<=nbins);
+    const unsigned long long* lane_counts = &counts[size_t(ilane)*nbins];
+    const unsigned long long* earlier_counts = &earlier.counts[size_t(ilane)*earlier.nbins];
+    unsigned long long entries = 0;
+    for (uint32_t value=0; value<nbins; value++) entries += lane_counts[value] - (value<earlier.nbins ? earlier_counts[value] : 0);
+    unsigned long long cumulative = 0;
+    for (uint32_t value=0; value<nbins; value++) {
+        cumulative += lane_counts[value] - (value<earlier.nbins ? earlier_counts[value] : 0);
+        if (cumulative>0 && cumulative >= q*entries) return value;
+    }
+    return 0;
+}
+
+void LaneOccupancyHistograms::grow(uint32_t min_nbins) {
+    uint32_t new_nbins = nbins;
+    while (new_nbins<min_nbins) new_nbins *= 2;
+    std::vector<unsigned long long> new_counts(size_t(nlanes)*new_nbins, 0);
+    for (int ilane=0; ilane<nlanes; ilane++) {
+        std::copy(counts.begin()+size_t(ilane)*nbins, counts.begin()+size_t(ilane+1)*nbins, new_counts.begin()+size_t(ilane)*new_nbins);
+    }
+    counts.swap(new_counts);
+    nbins = new_nbins;
+}
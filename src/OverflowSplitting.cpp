@@ -0,0 +1,112 @@
+#include <interface/OverflowSplitting.h>
+#include <include/StateStream.h>
+#include <sstream>
+#include <cmath>
+#include <assert.h>
+
+using namespace std;
+
+OverflowSplitting::OverflowSplitting(std::shared_ptr<Circuit> _circuit, std::shared_ptr<ChipDataPlayer> _player, std::function<uint32_t()> _occupancy,
+                                     const std::vector<uint32_t>& _levels, int _factor, uint64_t seed) :
+    circuit(_circuit), player(_player), occupancy(_occupancy), levels(_levels.size()), factor(_factor),
+    seed_rng(seed, RNG_STREAM_SPLITTING), crossing_weights(_levels.size()) {
+    assert(levels.size()>=2 && factor>=1);
+    for (int ilevel=0; ilevel<levels.size(); ilevel++) {
+        assert(ilevel==0 || _levels[ilevel]>_levels[ilevel-1]);
+        levels[ilevel].occupancy = _levels[ilevel];
+    }
+    reset_level = levels[0].occupancy/2;
+}
+
+std::string OverflowSplitting::save() {
+    std::ostringstream os(std::ios::binary);
+    StateWriter out(os);
+    circuit->save_state(out);
+    return os.str();
+}
+
+void OverflowSplitting::restore(const std::string& state) {
+    std::istringstream is(state, std::ios::binary);
+    StateReader in(is);
+    circuit->load_state(in);
+}
+
+void OverflowSplitting::split_crossing() {
+    std::fill(crossing_weights.begin(), crossing_weights.end(), 0.0);
+    std::string main_state = save();
+    split(0, 1.0);
+    restore(main_state);
+    levels[0].successes++;
+    levels[0].weights++;
+    levels[0].square_weights++;
+    for (int ilevel=1; ilevel<levels.size(); ilevel++) {
+        levels[ilevel].weights += crossing_weights[ilevel];
+        levels[ilevel].square_weights += crossing_weights[ilevel]*crossing_weights[ilevel];
+    }
+}
+
+void OverflowSplitting::split(int ilevel, double weight) {
+    std::string state = save();
+    double trial_weight = weight/factor;
+    for (int itrial=0; itrial<factor; itrial++) {
+        if (itrial>0) restore(state);
+        player->reseed(seed_rng());
+        levels[ilevel+1].trials++;
+        if (!run_trial(ilevel)) continue;
+        levels[ilevel+1].successes++;
+        crossing_weights[ilevel+1] += trial_weight;
+        if (ilevel+2<levels.size()) split(ilevel+1, trial_weight);
+    }
+}
+
+bool OverflowSplitting::run_trial(int ilevel) {
+    for (unsigned long long itick=0; itick<max_trial_ticks; ) {
+        circuit->tick();
+        uint32_t current = occupancy();
+        if (current>=levels[ilevel+1].occupancy) return true;
+        if (current<reset_level) return false;
+        // the occupancies don't change over idle ticks
+        itick += 1 + circuit->fast_forward(max_trial_ticks-itick);
+    }
+    truncated_trials++;
+    return false;
+}
+
+double OverflowSplitting::get_rate(int ilevel, unsigned long long nticks) const {
+    return nticks>0 ? levels[ilevel].weights/nticks : 0.0;
+}
+
+double OverflowSplitting::get_rate_error(int ilevel, unsigned long long nticks) const {
+    return nticks>0 ? 1.96*std::sqrt(levels[ilevel].square_weights)/nticks : 0.0;
+}
+
+void OverflowSplitting::write_json(std::ostream& os, unsigned long long nticks, double ticks_per_second) const {
+    // JSON has no infinity, the mean interval of a level never reached is null
+    auto write_interval = [&](double rate) {
+        if (rate>0) os<<1/rate;
+        else os<<"null";
+    };
+    os<<"{\"nticks\": "<<nticks<<", \"seconds\": "<<nticks/ticks_per_second<<", \"factor\": "<<factor<<", \"reset_level\": "<<reset_level;
+    os<<", \"truncated_trials\": "<<truncated_trials<<", \"max_trial_ticks\": "<<max_trial_ticks<<",\n\"levels\": [";
+    for (int ilevel=0; ilevel<levels.size(); ilevel++) {
+        const Level& level = levels[ilevel];
+        double rate = get_rate(ilevel, nticks)*ticks_per_second;
+        double error = get_rate_error(ilevel, nticks)*ticks_per_second;
+        os<<(ilevel>0 ? ",\n    " : "\n    ");
+        os<<"{\"occupancy\": "<<level.occupancy<<", \"kb\": "<<level.occupancy*64/1000.0;
+        os<<", \"trials\": "<<level.trials<<", \"successes\": "<<level.successes;
+        // the crossings of the first level come from the main run
+        os<<", \"conditional_probability\": ";
+        if (level.trials>0) os<<1.0*level.successes/level.trials;
+        else os<<"null";
+        os<<", \"rate_per_second\": "<<rate<<", \"rate_ci95\": ["<<std::max(0.0, rate-error)<<", "<<rate+error<<"]";
+        os<<", \"mean_interval_seconds\": ";
+        write_interval(rate);
+        os<<", \"mean_interval_ci95\": [";
+        write_interval(rate+error);
+        os<<", ";
+        write_interval(rate-error);
+        os<<"]}";
+    }
+    os<<"]}"<<std::endl;
+}
@@ -0,0 +1,107 @@
+#include<interface/ParallelCircuit.h>
+#include<algorithm>
+#include<map>
+#include<assert.h>
+
+using namespace std;
+
+void SpinBarrier::wait() {
+    unsigned gen = generation.load(std::memory_order_acquire);
+    if (arrived.fetch_add(1, std::memory_order_acq_rel) == nthreads-1) {
+        // last thread to arrive releases everybody else
+        arrived.store(0, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    int spins = 0;
+    while (generation.load(std::memory_order_acquire) == gen) {
+        if (++spins > 4096) std::this_thread::yield();
+    }
+}
+
+ParallelCircuit::ParallelCircuit(int _nthreads) : Circuit(), nthreads(std::max(_nthreads, 1)), thread_components(std::max(_nthreads, 1)), barrier(std::max(_nthreads, 1)) {
+    // thread 0 is the caller of tick(), only the others live in the pool
+    for (int ithread=1; ithread<nthreads; ithread++) {
+        workers.emplace_back(&ParallelCircuit::worker, this, ithread);
+    }
+};
+
+ParallelCircuit::~ParallelCircuit() {
+    stop.store(true);
+    if (nthreads>1) barrier.wait();
+    for (auto& t : workers) t.join();
+};
+
+// distribute partitions over threads, largest first onto the least loaded thread
+void ParallelCircuit::schedule() {
+    map<int, vector<Component*>> partitions;
+    vector<Component*> unpartitioned;
+    for (size_t icomp=0; icomp<components.size(); icomp++) {
+        if (component_partitions[icomp]<0) unpartitioned.push_back(components[icomp].get());
+        else partitions[component_partitions[icomp]].push_back(components[icomp].get());
+    }
+    vector<vector<Component*>*> sorted_partitions;
+    for (auto& partition : partitions) sorted_partitions.push_back(&partition.second);
+    std::stable_sort(sorted_partitions.begin(), sorted_partitions.end(), [](vector<Component*>* p1, vector<Component*>* p2) {return p1->size()>p2->size();});
+    for (auto& list : thread_components) list.clear();
+    auto least_loaded = [this]() {
+        return std::min_element(thread_components.begin(), thread_components.end(), [](const vector<Component*>& l1, const vector<Component*>& l2) {return l1.size()<l2.size();});
+    };
+    for (auto partition : sorted_partitions) {
+        auto thread_list = least_loaded();
+        thread_list->insert(thread_list->end(), partition->begin(), partition->end());
+    }
+    for (auto component : unpartitioned) least_loaded()->push_back(component);
+    scheduled_components = components.size();
+}
+
+void ParallelCircuit::run_tick(int ithread) {
+    for (auto component : thread_components[ithread]) {
+        PROFILE_COMPONENT(sampled, ithread, component, PHASE_TICK);
+        component->tick();
+    }
+}
+
+void ParallelCircuit::run_post_tick(int ithread) {
+    // the plane is swapped at once by the calling thread while the pool waits at the barrier
+    if (signal_plane) {
+        if (ithread==0) {
+            PROFILE_SECTION(sampled, 0, signal_plane_section);
+            signal_plane->swap();
+        }
+        return;
+    }
+    for (auto component : thread_components[ithread]) {
+        PROFILE_COMPONENT(sampled, ithread, component, PHASE_POST_TICK);
+        component->post_tick();
+    }
+}
+
+void ParallelCircuit::worker(int ithread) {
+    while (true) {
+        barrier.wait();
+        if (stop.load(std::memory_order_relaxed)) return;
+        run_tick(ithread);
+        barrier.wait();
+        run_post_tick(ithread);
+        barrier.wait();
+    }
+}
+
+void ParallelCircuit::tick() {
+    assert(components.size() == component_partitions.size());
+    if (scheduled_components != components.size()) schedule();
+#ifdef DTCQ_PROFILE
+    sampled = start_profiled_tick();
+#endif
+    if (nthreads==1) {
+        run_tick(0);
+        run_post_tick(0);
+        return;
+    }
+    barrier.wait(); // start
+    run_tick(0);
+    barrier.wait(); // all outputs computed before anything is propagated
+    run_post_tick(0);
+    barrier.wait(); // all inputs settled before the caller looks at the circuit
+};
@@ -0,0 +1,115 @@
+#include <interface/TickProfiler.h>
+#include <cxxabi.h>
+#include <typeinfo>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+
+#ifdef DTCQ_PROFILE
+static thread_local uint64_t thread_allocations = 0;
+
+// count every allocation of the program, new[] and the nothrow variants end up here
+void* operator new(size_t size) {
+    thread_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+
+uint64_t profile_thread_allocations() {return thread_allocations;}
+#else
+uint64_t profile_thread_allocations() {return 0;}
+#endif
+
+static std::string demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result(status==0 ? demangled : name);
+    free(demangled);
+    return result;
+}
+
+TickProfiler::TickProfiler(int _nthreads, int _sample_period) :
+    nthreads(std::max(_nthreads, 1)), sample_period(std::max(_sample_period, 1)), thread_counters(std::max(_nthreads, 1)),
+    start_cycles(profile_cycles()), start_time(std::chrono::steady_clock::now()) {}
+
+void TickProfiler::register_components(const std::vector<std::shared_ptr<Component>>& components) {
+#ifdef DTCQ_PROFILE
+    for (size_t icomp=registered_components.size(); icomp<components.size(); icomp++) {
+        Component* component = components[icomp].get();
+        std::string name = demangle(typeid(*component).name());
+        auto found = std::find(type_names.begin(), type_names.end(), name);
+        component->profile_type = found - type_names.begin();
+        if (found==type_names.end()) type_names.push_back(name);
+        registered_components.push_back(component);
+    }
+    for (auto& counters : thread_counters) counters.types.resize(type_names.size()*NPHASES);
+#endif
+}
+
+int TickProfiler::add_section(std::string name) {
+    section_names.push_back(name);
+    for (auto& counters : thread_counters) counters.sections.resize(section_names.size());
+    return section_names.size()-1;
+}
+
+void TickProfiler::write_json(std::ostream& os) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    double cycles_per_second = seconds>0 ? (profile_cycles() - start_cycles) / seconds : 0;
+    auto sum_threads = [this](std::vector<Counters> ThreadCounters::* member, size_t index) {
+        Counters sum;
+        for (auto& counters : thread_counters) {
+            sum.calls += (counters.*member)[index].calls;
+            sum.cycles += (counters.*member)[index].cycles;
+            sum.allocations += (counters.*member)[index].allocations;
+        }
+        return sum;
+    };
+    auto write_counters = [&os](const Counters& counters) {
+        os<<"{\"calls\": "<<counters.calls<<", \"cycles\": "<<counters.cycles<<", \"allocations\": "<<counters.allocations<<"}";
+    };
+    static const char* phase_names[NPHASES] = {"tick", "post_tick", "idle_ticks", "skip_ticks"};
+    os<<"{\"ticks\": "<<ticks<<", \"sampled_ticks\": "<<sampled_ticks<<", \"sample_period\": "<<sample_period;
+    os<<", \"threads\": "<<nthreads<<", \"cycles_per_second\": "<<cycles_per_second<<",\n";
+    os<<"  \"component_types\": [";
+    for (size_t itype=0; itype<type_names.size(); itype++) {
+        // fan-out of the output ports, and how often post_tick found a changed value to copy into the inputs
+        unsigned long long instances = 0, ports = 0, fanout = 0, max_fanout = 0, propagations = 0, changes = 0, input_writes = 0;
+        for (auto component : registered_components) {
+#ifdef DTCQ_PROFILE
+            if (component->profile_type!=int(itype)) continue;
+#endif
+            instances++;
+            for (auto port : component->get_output_ports()) {
+                ports++;
+                fanout += port->get_fanout();
+                max_fanout = std::max(max_fanout, (unsigned long long) port->get_fanout());
+#ifdef DTCQ_PROFILE
+                propagations += port->profile_propagations;
+                changes += port->profile_changes;
+                input_writes += port->profile_changes * port->get_fanout();
+#endif
+            }
+        }
+        os<<(itype>0 ? ",\n    " : "\n    ")<<"{\"name\": \""<<type_names[itype]<<"\", \"instances\": "<<instances;
+        os<<", \"output_ports\": "<<ports<<", \"fanout\": "<<fanout<<", \"max_fanout\": "<<max_fanout;
+        os<<", \"propagations\": "<<propagations<<", \"changes\": "<<changes<<", \"input_writes\": "<<input_writes;
+        for (int iphase=0; iphase<NPHASES; iphase++) {
+            os<<", \""<<phase_names[iphase]<<"\": ";
+            write_counters(sum_threads(&ThreadCounters::types, itype*NPHASES + iphase));
+        }
+        os<<"}";
+    }
+    os<<"],\n  \"sections\": [";
+    for (size_t isection=0; isection<section_names.size(); isection++) {
+        os<<(isection>0 ? ",\n    " : "\n    ")<<"{\"name\": \""<<section_names[isection]<<"\", \"counters\": ";
+        write_counters(sum_threads(&ThreadCounters::sections, isection));
+        os<<"}";
+    }
+    os<<"]}"<<std::endl;
+}
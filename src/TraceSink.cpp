@@ -0,0 +1,93 @@
+#include <interface/TraceSink.h>
+#include <chrono>
+#include <assert.h>
+
+using namespace std;
+
+AsyncTraceSink::AsyncTraceSink(std::unique_ptr<OccupancyContainerWriter> _container) : container(std::move(_container)) {}
+
+AsyncTraceSink::~AsyncTraceSink() {
+    close();
+}
+
+void AsyncTraceSink::add_source(const uint32_t* occupancies, const std::vector<int>& columns) {
+    assert(!running);
+    sources.push_back(Source{occupancies, int(columns.size())});
+    nlanes += columns.size();
+    lane_columns.insert(lane_columns.end(), columns.begin(), columns.end());
+}
+
+bool AsyncTraceSink::start() {
+    assert(nlanes==container->get_ncolumns());
+    if (!container->good()) return false;
+    blocks.resize(nblocks);
+    for (auto& block : blocks) {
+        block.values.resize(size_t(rows_per_block) * nlanes);
+        block.ticks.resize(rows_per_block);
+    }
+    running = true;
+    writer_thread = std::thread(&AsyncTraceSink::writer, this);
+    return true;
+}
+
+void AsyncTraceSink::submit_block() {
+    blocks[filled_blocks % nblocks].nrows = block_rows;
+    filled_blocks++;
+    submitted_blocks.store(filled_blocks, std::memory_order_release);
+    block_rows = 0;
+    // the next block is free once the writer thread is done with it
+    if (filled_blocks - written_blocks.load(std::memory_order_acquire) < nblocks) return;
+    auto stall_start = std::chrono::steady_clock::now();
+    stalls++;
+    while (filled_blocks - written_blocks.load(std::memory_order_acquire) >= nblocks) std::this_thread::yield();
+    stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stall_start).count();
+}
+
+void AsyncTraceSink::drain() {
+    assert(running);
+    if (block_rows>0) submit_block();
+    while (written_blocks.load(std::memory_order_acquire) != filled_blocks) std::this_thread::yield();
+}
+
+// the writer thread doesn't touch the container until the next block is submitted
+void AsyncTraceSink::save_state(StateWriter& out) {
+    drain();
+    container->save_state(out);
+}
+
+void AsyncTraceSink::load_state(StateReader& in) {
+    drain();
+    container->load_state(in);
+}
+
+void AsyncTraceSink::writer() {
+    unsigned long long iblock = 0;
+    std::vector<uint16_t> column_values(nlanes);
+    while (true) {
+        if (iblock == submitted_blocks.load(std::memory_order_acquire)) {
+            if (stop.load(std::memory_order_acquire) && iblock == submitted_blocks.load(std::memory_order_acquire)) break;
+            // idle, poll instead of waiting on a condition variable so that submitting never needs a syscall
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        const Block& block = blocks[iblock % nblocks];
+        for (int irow=0; irow<block.nrows; irow++) {
+            const uint16_t* row = block.values.data() + size_t(irow) * nlanes;
+            for (int ilane=0; ilane<nlanes; ilane++) column_values[lane_columns[ilane]] = row[ilane];
+            container->record(column_values.data(), block.ticks[irow]);
+        }
+        iblock++;
+        written_blocks.store(iblock, std::memory_order_release);
+    }
+    container->close();
+}
+
+bool AsyncTraceSink::close() {
+    if (running) {
+        running = false;
+        if (block_rows>0) submit_block();
+        stop.store(true, std::memory_order_release);
+        writer_thread.join();
+    }
+    return container->good();
+}
@@ -0,0 +1,103 @@
+#include <interface/TriggerSchedule.h>
+#include <cmath>
+
+using namespace std;
+
+TriggerSchedule::TriggerSchedule(const bool* bunch_not_empty, int _bunches_per_orbit, int _bunches_per_trigger, bool _use_trigger_rule, uint64_t seed) :
+    bunches_per_orbit(_bunches_per_orbit), use_trigger_rule(_use_trigger_rule),
+    rng(seed, RNG_STREAM_TRIGGER)
+    {
+    assert(_bunches_per_trigger > 0);
+    for (int ibunch=0; ibunch<bunches_per_orbit; ibunch++) {
+        if (bunch_not_empty[ibunch]) non_empty_bunches.push_back(ibunch);
+    }
+    // the first bunch crossing always triggers, so it has to be a non-empty bunch
+    assert(non_empty_bunches.size()>0 && non_empty_bunches[0]==0);
+    log_miss_probability = std::log1p(-1.0/_bunches_per_trigger);
+    batch.reserve(batch_size);
+}
+
+void TriggerSchedule::fill_batch() {
+    batch_start = {rng.get_seed(), rng.get_position(), next_non_empty_bunch, first_trigger, recent_L1A_bunch_crossings, recent_L1A_head, recent_L1A_count, potential_trigger_counts, blocked_trigger_counts};
+    batch.clear();
+    next_idx = 0;
+    generate(batch_size);
+}
+
+void TriggerSchedule::generate(size_t n) {
+    while (batch.size() < n) {
+        unsigned long long bunch_crossing;
+        // first event always trigger, otherwise skip a geometric number of non-empty bunches
+        if (first_trigger) {
+            bunch_crossing = 0;
+            next_non_empty_bunch = 1;
+            first_trigger = false;
+        }
+        else {
+            double u = rng.uniform_real();
+            unsigned long long missed_bunches = (unsigned long long) std::floor(std::log1p(-u) / log_miss_probability);
+            next_non_empty_bunch += missed_bunches;
+            bunch_crossing = nth_non_empty_bunch_crossing(next_non_empty_bunch++);
+        }
+        potential_trigger_counts += 1;
+        // Implemented trigger rule: no more than 8 triggers 130 bunch crossings
+        if (recent_L1A_count == trigger_rule_max_L1As && bunch_crossing - recent_L1A_bunch_crossings[recent_L1A_head] <= trigger_rule_bunch_period) {
+            blocked_trigger_counts += 1;
+            continue;
+        }
+        if (use_trigger_rule) {
+            recent_L1A_bunch_crossings[recent_L1A_head] = bunch_crossing;
+            recent_L1A_head = (recent_L1A_head + 1) % trigger_rule_max_L1As;
+            if (recent_L1A_count < trigger_rule_max_L1As) recent_L1A_count++;
+        }
+        batch.push_back({bunch_crossing, potential_trigger_counts, blocked_trigger_counts});
+    }
+}
+
+void TriggerSchedule::save_state(StateWriter& out) {
+    out.write(rng.get_seed());
+    out.write(rng.get_position());
+    out.write(next_non_empty_bunch);
+    out.write(first_trigger);
+    out.write(recent_L1A_bunch_crossings);
+    out.write(recent_L1A_head);
+    out.write(recent_L1A_count);
+    out.write(batch);
+    out.write(next_idx);
+    out.write(potential_trigger_counts);
+    out.write(blocked_trigger_counts);
+    out.write(batch_start);
+}
+
+void TriggerSchedule::load_state(StateReader& in) {
+    uint64_t seed = in.read<uint64_t>();
+    rng = CounterRNG(seed, RNG_STREAM_TRIGGER, in.read<uint64_t>());
+    in.read(next_non_empty_bunch);
+    in.read(first_trigger);
+    in.read(recent_L1A_bunch_crossings);
+    in.read(recent_L1A_head);
+    in.read(recent_L1A_count);
+    in.read(batch);
+    in.read(next_idx);
+    in.read(potential_trigger_counts);
+    in.read(blocked_trigger_counts);
+    in.read(batch_start);
+}
+
+// The batch holds triggers beyond the ones taken, drawn from the old stream and already in the trigger rule ring.
+// The batch is generated again from its start up to the triggers taken, then continues from the new stream.
+void TriggerSchedule::reseed(uint64_t seed) {
+    size_t taken = next_idx;
+    rng = CounterRNG(batch_start.rng_seed, RNG_STREAM_TRIGGER, batch_start.rng_position);
+    next_non_empty_bunch = batch_start.next_non_empty_bunch;
+    first_trigger = batch_start.first_trigger;
+    recent_L1A_bunch_crossings = batch_start.recent_L1A_bunch_crossings;
+    recent_L1A_head = batch_start.recent_L1A_head;
+    recent_L1A_count = batch_start.recent_L1A_count;
+    potential_trigger_counts = batch_start.potential_trigger_counts;
+    blocked_trigger_counts = batch_start.blocked_trigger_counts;
+    batch.clear();
+    generate(taken);
+    rng = CounterRNG(seed, RNG_STREAM_TRIGGER);
+    next_idx = taken;
+}
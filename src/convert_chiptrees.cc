@@ -0,0 +1,54 @@
+#include <interface/ChipTreeReader.h>
+#include <interface/EventSizeCache.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Convert the chiptrees.root of an input directory into the event size cache read by dtc at startup
+int main(int argc, char* argv[]) {
+    std::string input_dirname("input_dtc11_10kevt");
+    int NTHREADS=1;
+    std::string help_msg("Usage: ./build/convert_chiptrees [options]\n\
+            --help:                         display this message.\n\
+            --input/-i INPUT_DIRNAME:       input directory with chiptrees.root, the cache is written there as chiptrees.dtcq.\n\
+            --threads/-j N_Threads:         read the chip trees of a DTC on N_Threads threads. Default value = 1.\n");
+    for (int iarg =0; iarg<argc; iarg++) {
+        if (iarg==0) continue;
+        if (std::string(argv[iarg])=="--help") {std::cerr<<help_msg<<std::endl; return 0;}
+        if (std::string(argv[iarg])=="--input" || std::string(argv[iarg])=="-i") {
+            if (iarg+1 < argc) {
+                input_dirname = argv[++iarg];
+            }
+            else {
+                std::cerr<<"--input/-i option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--threads" || std::string(argv[iarg])=="-j") {
+            if (iarg+1 < argc) {
+                std::string input_nthreads_str(argv[++iarg]);
+                NTHREADS = stoi(input_nthreads_str);
+            }
+            else {
+                std::cerr<<"--threads/-j option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        std::cerr<<"Unknow option/argument: "<<argv[iarg]<<std::endl;
+        return 2;
+    }
+    while(input_dirname.back()=='/') input_dirname.pop_back();
+    std::string root_file_name = input_dirname + "/chiptrees.root";
+    std::string cache_file_name = input_dirname + "/chiptrees.dtcq";
+    std::vector<std::string> dtcnames = list_dtcs_in_root(root_file_name);
+    std::cout<<"Converting "<<dtcnames.size()<<" DTCs of "<<root_file_name<<" into "<<cache_file_name<<std::endl;
+    EventSizeCache::write(cache_file_name, root_file_name, dtcnames, [&root_file_name, NTHREADS](std::string dtcname) {
+        std::cout<<"Reading root file for "<<dtcname<<std::endl;
+        return read_dtc_from_root(root_file_name, dtcname, NTHREADS);
+    });
+    return 0;
+}
@@ -1,10 +1,13 @@
-#include <include/FIFO.h>
+#include <include/FIFOBank.h>
+#include <include/EventChipMatrix.h>
 #include <interface/Circuit.h>
+#include <interface/ParallelCircuit.h>
+#include <interface/StaticCircuit.h>
 #include <include/Component.h>
 #include <include/Ports.h>
 #include <ctime>
+#include <chrono>
 #include <deque>
-#include <regex>
 #include <algorithm>
 #include <iostream>
 #include <boost/filesystem.hpp>
@@ -14,25 +17,63 @@
 #include <random>
 #include <limits>
 #include <assert.h>
+#include <unistd.h>
 #include <bitset>
 #include <stdexcept>
 #include <interface/EventBoundaryFinder.h>
 #include <interface/ChipDataPlayer.h>
 #include <interface/DTCEventBuilder.h>
 #include <interface/ChipConfigReader.h>
-#include "TFile.h"
-#include "TDirectory.h"
-#include "TList.h"
-#include "TKey.h"
-#include "TTreeReader.h"
-#include "TTreeReaderValue.h"
+#include <interface/ChipTreeReader.h>
+#include <interface/EventSizeCache.h>
+#include <interface/EventChunkStream.h>
+#include <interface/TraceSink.h>
+#include <interface/OccupancyHistogram.h>
+#include <interface/BlockMaxima.h>
+#include <interface/EventLevelEngine.h>
+#include <interface/CapacityPlanner.h>
+#include <interface/OverflowSplitting.h>
+#include <interface/ConvergenceMonitor.h>
+#include <iomanip>
+#include <cmath>
+#include <sstream>
+#include <functional>
 
 using namespace std;
 //using namespace boost::filesystem;
 
-typedef FIFO<uint64_t> FIFO64;
-typedef FIFO<uint16_t> FIFO16;
+typedef FIFOBank<uint64_t> FIFOBank64;
+typedef FIFOBank<uint16_t> FIFOBank16;
 
+static const double clock_frequency = 400e6; // ticks per second, as FPGA_FREQUENCY in plot/eva.py
+
+// resident set size of this process from /proc, 0 if unavailable
+double resident_memory_mb() {
+    std::ifstream statm("/proc/self/statm");
+    unsigned long long total_pages = 0, resident_pages = 0;
+    if (!(statm>>total_pages>>resident_pages)) return 0;
+    return 1.0*resident_pages*sysconf(_SC_PAGESIZE)/1024/1024;
+}
+
+// wall-clock seconds since start, the CPU time of clock() adds up over the threads of -j
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the dtc circuit with all component types and run-time switches known at compile time
+template<bool RANDOM_L1, bool DO_PARSE>
+using DTCStaticCircuit = StaticCircuit<StaticChipDataPlayer<RANDOM_L1>, StaticTick<FIFOBank64>, StaticEventBoundaryFinder<DO_PARSE>, StaticTick<FIFOBank16>, StaticTick<DTCEventBuilder>>;
+
+std::shared_ptr<Circuit> make_static_circuit(bool random_l1, bool do_parse) {
+    if (random_l1) {
+        if (do_parse) return std::make_shared<DTCStaticCircuit<true, true>>();
+        else return std::make_shared<DTCStaticCircuit<true, false>>();
+    }
+    else {
+        if (do_parse) return std::make_shared<DTCStaticCircuit<false, true>>();
+        else return std::make_shared<DTCStaticCircuit<false, false>>();
+    }
+}
 
 int main(int argc, char* argv[]) {
 
@@ -50,12 +91,33 @@ int main(int argc, char* argv[]) {
     int nevents=1000;
     int NE=1;
     int PERIOD=0;
+    int BLOCK_MAXIMA_PERIOD=0;
+    int BLOCK_MAXIMA_LEVELS=7;
+    int NTHREADS=1;
+    bool FAST_FORWARD=false;
+    bool WRITE_TRACES=true;
+    bool STATIC_ENGINE=false;
+    bool SIGNAL_PLANE=false;
+    uint64_t SEED=233;
+    int STREAM_CHUNK=0;
+    int PROFILE_PERIOD=0;
+    bool EVENT_ENGINE=false;
+    bool CROSS_VALIDATE=false;
+    unsigned long long CHECKPOINT_EVERY=0;
+    std::string resume_filename("");
+    std::vector<uint32_t> SPLITTING_LEVELS;
+    bool SPLITTING_INPUT_FIFO=false;
+    int SPLITTING_FACTOR=4;
+    double CONVERGENCE_PRECISION=0;
+    unsigned long long BATCH_TICKS=1ull<<20;
+    bool seed_given=false;
 
     // argument parsing
     std::string help_msg("Usage: ./build/dtc [options]\n\
             --help:                         display this message.\n\
             --debug:                        enable some debug output.\n\
-            --dry-run:                      print out event builder assignment without actually running the simulation.\n\
+            --dry-run:                      print out event builder assignment and the analytic link loads and FIFO occupancy estimates of capacity_plan.json\n\
+                                            without actually running the simulation.\n\
             --input/-i INPUT_DIRNAME:       Change the input directory name, by default uses input_10k.\n\
             --assignment/-a MODE:           Mode to assign chips to event builders. Can be orignal, random, or sorted.\n\
             --config/-c CONFIG_FILENAME:    Config file that include n-elinks and n-events-compression per chip, by default uses config/default.config.\n\
@@ -65,7 +127,32 @@ int main(int argc, char* argv[]) {
             --random-l1 L1-TYPE:            L1-TYPE is boolean, set whether L1 trigger rate random with average of 750kHZ or just constantly 750kHz.\n\
             --no-trigger-rule:              Only effective for the random L1 trigger mode, disables the trigger rules.\n\
             --log-max-only PERIOD:          Log only the global maximum every PERIOD of clock cycles.\n\
-            --output-links N_OptLinks:      set the number of output optical links, each connects to a event builder. Default value = 12.\n");
+            --block-maxima PERIOD:          histogram the FIFO occupancy maxima per chip, per event builder and of the whole DTC over blocks of PERIOD*2^k clock cycles into block_maxima.json.\n\
+            --block-maxima-levels N_Levels: number of block lengths k=0..N_Levels-1 of --block-maxima. Default value = 7.\n\
+            --output-links N_OptLinks:      set the number of output optical links, each connects to a event builder. Default value = 12.\n\
+            --threads/-j N_Threads:         tick the event builder partitions of the circuit, and read the chip trees, on N_Threads threads. Default value = 1.\n\
+            --no-traces:                    don't write the per-chip occupancy traces to occupancy.dtcq, the histograms in occupancy_summary.json are always written.\n\
+            --fast-forward:                 skip the clock ticks over which the whole circuit is idle, FIFO occupancies are filled in for the skipped ticks.\n\
+            --static-engine:                tick the circuit with the component types fixed at compile time (no virtual calls). Single thread only.\n\
+            --signal-plane:                 keep all wires in one contiguous double-buffered array instead of copying port values.\n\
+            --seed SEED:                    seed of the random streams for triggers, event sampling and random assignment. Default value = 233.\n\
+            --stream-chunk N_Events:        stream the input in chunks of N_Events read ahead on a separate thread instead of loading it whole, events are sampled within the current chunk.\n\
+            --profile N_Ticks:              time the components and count their allocations every N_Ticks clock cycles, written to profile.json. Needs a build with -DDTCQ_PROFILE=ON.\n\
+            --engine ENGINE:                tick (default) runs the cycle-accurate circuit, event runs the event-level engine, which jumps over the ticks\n\
+                                            on which nothing changes and only writes occupancy_summary.json.\n\
+            --cross-validate:               run both engines on the same input and compare their occupancy distributions in cross_validation.json,\n\
+                                            exit code 5 if they differ by more than the tolerances.\n\
+            --checkpoint-every N_Ticks:     save the whole simulation state to checkpoint.bin in the output dir every N_Ticks clock cycles.\n\
+            --resume CHECKPOINT_FILE:       continue the run saved in CHECKPOINT_FILE, with the same options as the run that wrote it.\n\
+                                            Checkpoints can't be combined with --stream-chunk, occupancy.dtcq is cut back to the checkpoint on resume.\n\
+            --splitting LEVELS:             comma-separated ascending occupancies in words (1 word = 64 bits, e.g. 282,563,844,1125 for 18,36,54,72 kb) of the\n\
+                                            largest output FIFO occupancy, whose rates of being reached are estimated by multilevel splitting into splitting.json.\n\
+            --splitting-fifo FIFO:          FIFO type of --splitting, output (default) or input.\n\
+            --splitting-factor R:           number of trajectories cloned at each level of --splitting. Default value = 4.\n\
+            --until-converged PRECISION:    stop before --nevents once the 95% confidence intervals of the per-chip p99.9 FIFO occupancies and of the\n\
+                                            DTC maxima, from the means over batches of ticks, are within PRECISION of them (e.g. 0.05), and the global\n\
+                                            maxima haven't grown over the last 10 batches, into convergence.json.\n\
+            --batch-ticks N_Ticks:          batch length of --until-converged. Default value = 1048576.\n");
     for (int iarg =0; iarg<argc; iarg++) {
         if (iarg==0) continue;
         if (std::string(argv[iarg])=="--help") {std::cerr<<help_msg<<std::endl; return 0;}
@@ -135,6 +222,60 @@ int main(int argc, char* argv[]) {
             TRIGGER_RULE = false;
             continue;
         }
+        if (std::string(argv[iarg])=="--seed") {
+            if (iarg+1 < argc) {
+                std::string input_seed_str(argv[++iarg]);
+                SEED = stoull(input_seed_str);
+                seed_given = true;
+            }
+            else {
+                std::cerr<<"--seed option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--stream-chunk") {
+            if (iarg+1 < argc) {
+                std::string stream_chunk_str(argv[++iarg]);
+                STREAM_CHUNK = stoi(stream_chunk_str);
+            }
+            else {
+                std::cerr<<"--stream-chunk option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--profile") {
+            if (iarg+1 < argc) {
+                std::string profile_period_str(argv[++iarg]);
+                PROFILE_PERIOD = stoi(profile_period_str);
+            }
+            else {
+                std::cerr<<"--profile option requires one argument."<<std::endl;
+                return 1;
+            }
+#ifndef DTCQ_PROFILE
+            std::cerr<<"--profile requires a build with -DDTCQ_PROFILE=ON."<<std::endl;
+            return 1;
+#endif
+            continue;
+        }
+        if (std::string(argv[iarg])=="--signal-plane") {
+            SIGNAL_PLANE = true;
+            continue;
+        }
+        if (std::string(argv[iarg])=="--static-engine") {
+            STATIC_ENGINE = true;
+            continue;
+        }
+        if (std::string(argv[iarg])=="--no-traces") {
+            WRITE_TRACES = false;
+            continue;
+        }
+        if (std::string(argv[iarg])=="--fast-forward") {
+            FAST_FORWARD = true;
+            continue;
+        }
         if (std::string(argv[iarg])=="--dry-run") {
             DRY_RUN = true;
             continue;
@@ -150,6 +291,28 @@ int main(int argc, char* argv[]) {
             }
             continue;
         }
+        if (std::string(argv[iarg])=="--block-maxima") {
+            if (iarg+1 < argc) {
+                std::string block_maxima_period_str(argv[++iarg]);
+                BLOCK_MAXIMA_PERIOD = stoi(block_maxima_period_str);
+            }
+            else {
+                std::cerr<<"--block-maxima option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--block-maxima-levels") {
+            if (iarg+1 < argc) {
+                std::string block_maxima_levels_str(argv[++iarg]);
+                BLOCK_MAXIMA_LEVELS = stoi(block_maxima_levels_str);
+            }
+            else {
+                std::cerr<<"--block-maxima-levels option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
         if (std::string(argv[iarg])=="--output-links") {
             if (iarg+1 < argc) {
                 std::string output_links_str(argv[++iarg]);
@@ -161,6 +324,17 @@ int main(int argc, char* argv[]) {
             }
             continue;
         }
+        if (std::string(argv[iarg])=="--threads" || std::string(argv[iarg])=="-j") {
+            if (iarg+1 < argc) {
+                std::string input_nthreads_str(argv[++iarg]);
+                NTHREADS = stoi(input_nthreads_str);
+            }
+            else {
+                std::cerr<<"--threads/-j option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
         if (std::string(argv[iarg])=="--nevents" || std::string(argv[iarg])=="-n") {
             if (iarg+1 < argc) {
                 std::string input_nevents_str(argv[++iarg]);
@@ -183,9 +357,164 @@ int main(int argc, char* argv[]) {
             }
             continue;
         }
+        if (std::string(argv[iarg])=="--engine") {
+            if (iarg+1 < argc) {
+                std::string engine_str(argv[++iarg]);
+                if (engine_str=="event") EVENT_ENGINE = true;
+                else if (engine_str=="tick") EVENT_ENGINE = false;
+                else {
+                    std::cerr<<"--engine option must be tick or event."<<std::endl;
+                    return 1;
+                }
+            }
+            else {
+                std::cerr<<"--engine option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--cross-validate") {
+            CROSS_VALIDATE = true;
+            continue;
+        }
+        if (std::string(argv[iarg])=="--checkpoint-every") {
+            if (iarg+1 < argc) {
+                std::string checkpoint_every_str(argv[++iarg]);
+                CHECKPOINT_EVERY = stoull(checkpoint_every_str);
+            }
+            else {
+                std::cerr<<"--checkpoint-every option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--splitting") {
+            if (iarg+1 < argc) {
+                std::stringstream levels_str(argv[++iarg]);
+                std::string level_str;
+                while (std::getline(levels_str, level_str, ',')) SPLITTING_LEVELS.push_back(stoul(level_str));
+            }
+            else {
+                std::cerr<<"--splitting option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--splitting-fifo") {
+            if (iarg+1 < argc) {
+                std::string fifo_str(argv[++iarg]);
+                if (fifo_str=="input") SPLITTING_INPUT_FIFO = true;
+                else if (fifo_str=="output") SPLITTING_INPUT_FIFO = false;
+                else {
+                    std::cerr<<"--splitting-fifo option must be input or output."<<std::endl;
+                    return 1;
+                }
+            }
+            else {
+                std::cerr<<"--splitting-fifo option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--splitting-factor") {
+            if (iarg+1 < argc) {
+                std::string factor_str(argv[++iarg]);
+                SPLITTING_FACTOR = stoi(factor_str);
+            }
+            else {
+                std::cerr<<"--splitting-factor option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--until-converged") {
+            if (iarg+1 < argc) {
+                std::string precision_str(argv[++iarg]);
+                CONVERGENCE_PRECISION = stod(precision_str);
+            }
+            else {
+                std::cerr<<"--until-converged option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--batch-ticks") {
+            if (iarg+1 < argc) {
+                std::string batch_ticks_str(argv[++iarg]);
+                BATCH_TICKS = stoull(batch_ticks_str);
+            }
+            else {
+                std::cerr<<"--batch-ticks option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--resume") {
+            if (iarg+1 < argc) {
+                resume_filename = argv[++iarg];
+            }
+            else {
+                std::cerr<<"--resume option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
         std::cerr<<"Unknow option/argument: "<<argv[iarg]<<std::endl;
         return 2;
     }
+    if (STATIC_ENGINE && NTHREADS>1) {
+        std::cerr<<"--static-engine can't be combined with --threads/-j."<<std::endl;
+        return 1;
+    }
+    if (BLOCK_MAXIMA_PERIOD<0 || BLOCK_MAXIMA_LEVELS<1 || BLOCK_MAXIMA_LEVELS>63) {
+        std::cerr<<"--block-maxima needs a non-negative period and --block-maxima-levels between 1 and 63."<<std::endl;
+        return 1;
+    }
+    if (EVENT_ENGINE && (PERIOD>0 || BLOCK_MAXIMA_PERIOD>0)) {
+        std::cerr<<"--engine event only writes the occupancy histograms, it can't be combined with --log-max-only or --block-maxima."<<std::endl;
+        return 1;
+    }
+    if (CROSS_VALIDATE && EVENT_ENGINE) {
+        std::cerr<<"--cross-validate runs both engines, it can't be combined with --engine event."<<std::endl;
+        return 1;
+    }
+    if ((EVENT_ENGINE || CROSS_VALIDATE) && !RANDOM_L1) {
+        std::cerr<<"--engine event and --cross-validate only model the random L1 triggers, they can't be combined with --random-l1 false."<<std::endl;
+        return 1;
+    }
+    if (CROSS_VALIDATE && STREAM_CHUNK>0) {
+        std::cerr<<"--cross-validate reads the input twice, it can't be combined with --stream-chunk."<<std::endl;
+        return 1;
+    }
+    bool CHECKPOINTS = CHECKPOINT_EVERY>0 || resume_filename!="";
+    if (CHECKPOINTS && (EVENT_ENGINE || STREAM_CHUNK>0)) {
+        std::cerr<<"--checkpoint-every and --resume save the state of the tick engine with the whole input loaded, ";
+        std::cerr<<"they can't be combined with --engine event or --stream-chunk."<<std::endl;
+        return 1;
+    }
+    if (CONVERGENCE_PRECISION<0 || BATCH_TICKS==0) {
+        std::cerr<<"--until-converged needs a positive precision and --batch-ticks a positive length."<<std::endl;
+        return 1;
+    }
+    if (CONVERGENCE_PRECISION>0 && (EVENT_ENGINE || CROSS_VALIDATE)) {
+        std::cerr<<"--until-converged stops the tick engine, it can't be combined with --engine event or --cross-validate."<<std::endl;
+        return 1;
+    }
+    if (SPLITTING_LEVELS.size()>0) {
+        if (SPLITTING_LEVELS.size()<2 || !std::is_sorted(SPLITTING_LEVELS.begin(), SPLITTING_LEVELS.end(), std::less_equal<uint32_t>()) || SPLITTING_LEVELS[0]<2) {
+            std::cerr<<"--splitting needs at least two strictly ascending levels, the first one at least 2 words."<<std::endl;
+            return 1;
+        }
+        if (SPLITTING_FACTOR<1) {
+            std::cerr<<"--splitting-factor must be at least 1."<<std::endl;
+            return 1;
+        }
+        if (EVENT_ENGINE || STREAM_CHUNK>0 || CHECKPOINTS) {
+            std::cerr<<"--splitting clones the state of the tick engine with the whole input loaded, ";
+            std::cerr<<"it can't be combined with --engine event, --stream-chunk or checkpoints."<<std::endl;
+            return 1;
+        }
+    }
 
     // print out parameters and setup the output dir
     std::string output_dir("output/");
@@ -198,7 +527,7 @@ int main(int argc, char* argv[]) {
     output_dir+=input_tag+"_"+dtcname+tag;
     if (RANDOM_L1) output_dir+="_randomL1"; else output_dir+="_constL1";
     if (RANDOM_L1 && !TRIGGER_RULE)  output_dir+="NoTriggerRule";
-    std::cout<<"Running Mode: Randome L1="<<RANDOM_L1<<" TRIGGER_RULE="<<TRIGGER_RULE<<" OUTPUT_LINKS="<<OUTPUT_LINKS;
+    std::cout<<"Running Mode: Randome L1="<<RANDOM_L1<<" TRIGGER_RULE="<<TRIGGER_RULE<<" OUTPUT_LINKS="<<OUTPUT_LINKS<<" THREADS="<<NTHREADS<<" SEED="<<SEED;
     output_dir+="_";
     output_dir+=config_filename.substr(config_filename.find_last_of("/")+1, config_filename.find_last_of(".")-config_filename.find_last_of("/")-1);
     output_dir+="_olinks";
@@ -214,78 +543,72 @@ int main(int argc, char* argv[]) {
         output_dir+="_MaxOnly";
         output_dir+=to_string(PERIOD);
     }
+    if (seed_given) {
+        output_dir+="_seed";
+        output_dir+=to_string(SEED);
+    }
+    if (STREAM_CHUNK>0) {
+        output_dir+="_stream";
+        output_dir+=to_string(STREAM_CHUNK);
+    }
+    if (EVENT_ENGINE) output_dir+="_eventEngine";
     std::cout<<" Output dir="<<output_dir<<std::endl;
     boost::filesystem::create_directories("output");
     boost::filesystem::create_directories(output_dir);
 
-    // read the root file, get a list of event sizes for relavent chips
+    // read the event sizes for relavent chips, from the event size cache when it was converted, otherwise from the root file
     // save chip the ordered chip information into txt file
+    std::cout<<"resident memory before reading input="<<resident_memory_mb()<<" MB"<<std::endl;
+    auto read_timer = std::chrono::steady_clock::now();
+    DTCInput dtc_input;
+    // in streaming mode, only chunks of STREAM_CHUNK events are held in memory
+    std::shared_ptr<EventChunkSource> event_chunk_source;
+    string cache_file_name = (input_dirname + "/chiptrees.dtcq");
     string root_file_name = (input_dirname + "/chiptrees.root");
-    TFile* input_root_file = TFile::Open(root_file_name.c_str());
-    TDirectory* dtcdir = (TDirectory*) input_root_file->Get(dtcname.c_str());
-    assert(dtcdir); //make sure this directory exists in root file
-    int nchips = dtcdir->GetNkeys();
-    assert(nchips>0);
-    std::vector<TTree*> vec_trees(nchips);
-    int itree = 0;
-    // get list of chip trees
-    for (const auto && key : *dtcdir->GetListOfKeys()) {
-        vec_trees[itree] = (TTree*) ((TKey*)key)->ReadObj();
-        itree++;
-    }
-    int input_events = vec_trees[0]->GetEntries();
-    // initialize the chip sizes as 2d vectors, rows=input_events, cols=nchips
-    std::vector<std::vector<unsigned short>> vec_event_chip_sizes(input_events, std::vector<unsigned short>(nchips));
-    std::vector<std::vector<unsigned short>> vec_event_chip_parse_time(input_events, std::vector<unsigned short>(nchips));
+    bool use_cache = boost::filesystem::exists(cache_file_name);
+    if (use_cache) {
+        EventSizeCache cache(cache_file_name);
+        // without the root file next to it, the cache is all there is to read
+        if (boost::filesystem::exists(root_file_name) && cache.is_stale(root_file_name)) {
+            std::cerr<<"Warning: "<<root_file_name<<" changed since "<<cache_file_name<<" was converted, reading the root file instead, run convert_chiptrees again"<<std::endl;
+            use_cache = false;
+        }
+        else {
+            if (!cache.has_dtc(dtcname)) {std::cerr<<dtcname<<" is not in "<<cache_file_name<<std::endl; return 3;}
+            std::cout<<"Reading event size cache for "<<dtcname<<std::endl;
+            if (STREAM_CHUNK>0) event_chunk_source = cache.open_stream(dtcname);
+            else dtc_input = cache.load(dtcname);
+        }
+    }
+    if (!use_cache) {
+        std::cout<<"Reading root file for "<<dtcname<<", run convert_chiptrees once to start faster"<<std::endl;
+        if (STREAM_CHUNK>0) event_chunk_source = open_dtc_stream_from_root(root_file_name, dtcname);
+        else dtc_input = read_dtc_from_root(root_file_name, dtcname, NTHREADS);
+    }
+    // the chip sizes and parsing times in one matrix, rows=input_events, cols=nchips, shared with the data player
+    std::shared_ptr<EventChipMatrix> event_chip_matrix = dtc_input.event_chip_matrix;
+    std::shared_ptr<EventChunkStream> event_stream;
+    if (event_chunk_source) {
+        dtc_input.chips = event_chunk_source->get_chips();
+        event_stream = std::make_shared<EventChunkStream>(event_chunk_source, STREAM_CHUNK);
+        std::cout<<"Streaming "<<event_chunk_source->get_nevents()<<" input events in chunks of "<<STREAM_CHUNK<<std::endl;
+    }
+    int nchips = dtc_input.chips.size();
+    std::cout<<"Read input in "<<1000.0*seconds_since(read_timer)<<" ms, nchips="<<nchips<<std::endl;
     std::vector<std::string> chip_basename_list(nchips);
-    // be ready to write the order of chips into txt file
     std::ofstream os_chip_order(output_dir+"/ordered_chips.csv");
-    std::cout<<"Reading root file for "<<dtcname<<" nchips="<<nchips<<std::endl;
     os_chip_order<<"index  dtc    barrel layer  disk   module chip"<<std::endl;
     for (int ichip=0; ichip<nchips; ichip++) {
-        TTreeReader chip_reader(vec_trees[ichip]);
-        TTreeReaderValue<int>  branch_dtc          ( chip_reader , "dtc");
-        TTreeReaderValue<bool> branch_barrel       ( chip_reader , "barrel");
-        TTreeReaderValue<int>  branch_layer        ( chip_reader , "layer");
-        TTreeReaderValue<int>  branch_disk         ( chip_reader , "disk");
-        TTreeReaderValue<int>  branch_module_id    ( chip_reader , "module_id");
-        TTreeReaderValue<int>  branch_module_index ( chip_reader , "module_index");
-        TTreeReaderValue<int>  branch_size_pad     ( chip_reader , "stream_size_chip_aurora_pad");
-        TTreeReaderValue<int>  branch_parse_time   ( chip_reader , "parsing_time");
-        int ievent = 0;
-        chip_reader.Restart();
-        while (chip_reader.Next()) {
-            assert(*branch_size_pad < 65536);
-            assert(*branch_parse_time < 65536);
-            vec_event_chip_sizes[ievent][ichip] = *branch_size_pad;
-            vec_event_chip_parse_time[ievent][ichip] = *branch_parse_time;
-            ievent += 1;
-        }
-        chip_reader.Restart();
-        chip_reader.Next();
-        assert(ievent==input_events);
-        std::regex rgx("module([0-9]+)chip([0-9]+)");
-        std::smatch matches;
-        std::string treename = vec_trees[ichip]->GetName();
-        std::regex_search(treename, matches, rgx);
-        assert(matches.size()==3);
-        os_chip_order<<std::setw(7)<<std::left<<matches[1].str();
-        os_chip_order<<std::setw(7)<<std::left<<*branch_dtc;
-        os_chip_order<<std::setw(7)<<std::left<<*branch_barrel;
-        os_chip_order<<std::setw(7)<<std::left<<*branch_layer;
-        os_chip_order<<std::setw(7)<<std::left<<*branch_disk;
-        os_chip_order<<std::setw(7)<<std::left<<*branch_module_id;
-        os_chip_order<<std::setw(7)<<std::left<<matches[2].str();
+        const ChipInfo& chip_info = dtc_input.chips[ichip];
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.tree_module;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.dtc;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.barrel;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.layer;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.disk;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.module_id;
+        os_chip_order<<std::setw(7)<<std::left<<chip_info.chip;
         os_chip_order<<std::endl;
-        // construct basename
-        std::string chip_basename("dtc");
-        chip_basename += std::to_string(*branch_dtc)    + "isBarrel";
-        chip_basename += std::to_string(*branch_barrel) + "layer";
-        chip_basename += std::to_string(*branch_layer)  + "disk";
-        chip_basename += std::to_string(*branch_disk)   + "module";
-        chip_basename += std::to_string(*branch_module_id) + "chip";
-        chip_basename += matches[2].str();
-        chip_basename_list[ichip] = chip_basename;
+        chip_basename_list[ichip] = chip_info.basename();
     }
     os_chip_order.close();
 
@@ -294,7 +617,7 @@ int main(int argc, char* argv[]) {
     ChipConfigReader config(config_filename);
 
     // assign the chips to the event builders
-    std::vector<int> eb_assignment = config.assign_chips_to_event_builders(chip_basename_list, OUTPUT_LINKS, assignment_mode);
+    std::vector<int> eb_assignment = config.assign_chips_to_event_builders(chip_basename_list, OUTPUT_LINKS, assignment_mode, SEED);
     std::vector<int> nchips_per_eb(OUTPUT_LINKS, 0);
     std::vector<int> ichip_to_ichip_per_eb(nchips);
     for (int ichip=0; ichip<nchips; ichip++) {
@@ -327,36 +650,102 @@ int main(int argc, char* argv[]) {
     std::cout        <<"sum_of_avgsize="<<sum_of_avgsize<<std::endl;
     }
     log_eb_assignment.close();
-
-    // setup circuit and components
-    auto circuit = std::make_shared<Circuit>();
     // read the elink to chip ratio and configure data player accordingly
     std::vector<float> elink_chip_ratio = config.GetNELinkVector(chip_basename_list); // n-elinks/n-chips for each chip
+
+    // summary of the occupancy distributions, read by plot/plot.py instead of the traces
+    auto write_occupancy_summary = [&](unsigned long long nticks, const std::vector<LaneOccupancyHistograms>& histograms_input, const OccupancyHistogram& total_input,
+                                       const std::vector<LaneOccupancyHistograms>& histograms_output_data, const OccupancyHistogram& total_output_data) {
+        std::ofstream os_summary(output_dir+"/occupancy_summary.json");
+        auto write_fifo_summary = [&](std::string fifo_name, const std::vector<LaneOccupancyHistograms>& fifo_histograms, const OccupancyHistogram& total) {
+            os_summary<<"\""<<fifo_name<<"\": {\n    \"total\": ";
+            total.write_json(os_summary);
+            os_summary<<",\n    \"event_builders\": [";
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                os_summary<<(ieb>0 ? ",\n        " : "\n        ");
+                fifo_histograms[ieb].get_sum_histogram().write_json(os_summary);
+            }
+            os_summary<<"],\n    \"chips\": {";
+            for (int ichip=0; ichip<nchips; ichip++) {
+                os_summary<<(ichip>0 ? ",\n        " : "\n        ")<<"\""<<chip_basename_list[ichip]<<"\": ";
+                fifo_histograms[eb_assignment[ichip]].lane_histogram(ichip_to_ichip_per_eb[ichip]).write_json(os_summary);
+            }
+            os_summary<<"}}";
+        };
+        os_summary<<"{\"nticks\": "<<nticks<<",\n";
+        write_fifo_summary("input_fifo", histograms_input, total_input);
+        os_summary<<",\n";
+        write_fifo_summary("output_fifo_data", histograms_output_data, total_output_data);
+        os_summary<<"}"<<std::endl;
+        std::cout<<"input FIFO occupancy p99="<<total_input.quantile(0.99)<<" p99.99="<<total_input.quantile(0.9999)<<", output FIFO (data) occupancy p99="<<total_output_data.quantile(0.99)<<" p99.99="<<total_output_data.quantile(0.9999)<<std::endl;
+    };
+
+    // event-level engine, on its own player built from the same input, seed and options as the one of the circuit
+    std::unique_ptr<EventLevelEngine> event_engine;
+    unsigned long long event_engine_nticks = 0;
+    double event_engine_seconds = 0;
+    if ((EVENT_ENGINE || CROSS_VALIDATE) && !DRY_RUN) {
+        std::shared_ptr<ChipDataPlayer> event_engine_player;
+        if (event_stream) event_engine_player = std::make_shared<ChipDataPlayer>(nchips, event_stream, elink_chip_ratio, NE, RANDOM_L1, TRIGGER_RULE, SEED);
+        else event_engine_player = std::make_shared<ChipDataPlayer>(nchips, event_chip_matrix, elink_chip_ratio, NE, RANDOM_L1, TRIGGER_RULE, SEED);
+        event_engine = std::make_unique<EventLevelEngine>(event_engine_player, eb_assignment, OUTPUT_LINKS, NE>1);
+        std::cout<<"running the event-level engine..."<<std::endl;
+        auto event_engine_timer = std::chrono::steady_clock::now();
+        event_engine_nticks = event_engine->run(nevents);
+        event_engine_seconds = seconds_since(event_engine_timer);
+        std::cout<<"event-level engine: total ticks="<<event_engine_nticks<<", running time="<<event_engine_seconds<<" seconds"<<std::endl;
+        if (EVENT_ENGINE) {
+            write_occupancy_summary(event_engine_nticks, event_engine->get_histograms(OCCUPANCY_FIFO_INPUT), event_engine->get_total_histogram(OCCUPANCY_FIFO_INPUT),
+                                    event_engine->get_histograms(OCCUPANCY_FIFO_OUTPUT_DATA), event_engine->get_total_histogram(OCCUPANCY_FIFO_OUTPUT_DATA));
+            return 0;
+        }
+    }
+
+    // setup circuit and components
+    // each event builder with its chips forms an independent partition, only the data player is shared
+    std::shared_ptr<Circuit> circuit;
+    if (NTHREADS>1) circuit = std::make_shared<ParallelCircuit>(NTHREADS);
+    else if (STATIC_ENGINE) circuit = make_static_circuit(RANDOM_L1, NE>1);
+    else circuit = std::make_shared<Circuit>();
     if (DEBUG) std::cout<<"Creating player object"<<std::endl;
-    auto player  = std::make_shared<ChipDataPlayer>(nchips, vec_event_chip_sizes, vec_event_chip_parse_time, elink_chip_ratio, NE, RANDOM_L1, TRIGGER_RULE);
+    std::shared_ptr<ChipDataPlayer> player;
+    if (event_stream) player = std::make_shared<ChipDataPlayer>(nchips, event_stream, elink_chip_ratio, NE, RANDOM_L1, TRIGGER_RULE, SEED);
+    else player = std::make_shared<ChipDataPlayer>(nchips, event_chip_matrix, elink_chip_ratio, NE, RANDOM_L1, TRIGGER_RULE, SEED);
     if (DEBUG) std::cout<<"Created player object"<<std::endl;
+    if (event_chip_matrix) std::cout<<"input event matrix="<<event_chip_matrix->get_bytes()/1024.0/1024.0<<" MB, ";
+    std::cout<<"resident memory with data player="<<resident_memory_mb()<<" MB"<<std::endl;
     circuit->add_component(player);
     std::vector<std::shared_ptr<DTCEventBuilder>> evt_builders;
     for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
         evt_builders.push_back(std::make_shared<DTCEventBuilder>(nchips_per_eb[ieb], 1)); 
-        circuit->add_component(evt_builders[ieb]);
+        circuit->add_component(evt_builders[ieb], ieb);
     }
 
-    std::vector<std::shared_ptr<FIFO64>>              fifos_input;
-    std::vector<std::shared_ptr<FIFO64>>              fifos_output_data;
-    std::vector<std::shared_ptr<FIFO16>>              fifos_output_control;
+    // the FIFOs of all chips read by the same event builder are stored together in one bank per FIFO type,
+    // the wiring below goes through the per-chip lanes of the banks
+    std::vector<std::shared_ptr<FIFOBank64>>          fifo_banks_input;
+    std::vector<std::shared_ptr<FIFOBank64>>          fifo_banks_output_data;
+    std::vector<std::shared_ptr<FIFOBank16>>          fifo_banks_output_control;
+    for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+        fifo_banks_input.push_back(std::make_shared<FIFOBank64>(nchips_per_eb[ieb]));
+        fifo_banks_output_data.push_back(std::make_shared<FIFOBank64>(nchips_per_eb[ieb]));
+        fifo_banks_output_control.push_back(std::make_shared<FIFOBank16>(nchips_per_eb[ieb]));
+        circuit->add_component(fifo_banks_input[ieb], ieb);
+        circuit->add_component(fifo_banks_output_data[ieb], ieb);
+        circuit->add_component(fifo_banks_output_control[ieb], ieb);
+    }
+    std::vector<FIFOBank64::Lane*>                    fifos_input;
+    std::vector<FIFOBank64::Lane*>                    fifos_output_data;
+    std::vector<FIFOBank16::Lane*>                    fifos_output_control;
     std::vector<std::shared_ptr<EventBoundaryFinder>> ebfs;
     for (int ichip=0; ichip<nchips; ichip++){
         int ieb = eb_assignment[ichip];
         int ichip_per_eb = ichip_to_ichip_per_eb[ichip];
-        fifos_input.push_back(std::make_shared<FIFO64>());
-        fifos_output_data.push_back(std::make_shared<FIFO64>());
-        fifos_output_control.push_back(std::make_shared<FIFO16>());
+        fifos_input.push_back(fifo_banks_input[ieb]->lane(ichip_per_eb));
+        fifos_output_data.push_back(fifo_banks_output_data[ieb]->lane(ichip_per_eb));
+        fifos_output_control.push_back(fifo_banks_output_control[ieb]->lane(ichip_per_eb));
         ebfs.push_back(std::make_shared<EventBoundaryFinder>(NE>1));
-        circuit->add_component(fifos_input[ichip]);
-        circuit->add_component(fifos_output_data[ichip]);
-        circuit->add_component(fifos_output_control[ichip]);
-        circuit->add_component(ebfs[ichip] );
+        circuit->add_component(ebfs[ichip], ieb);
         player->out_data[ichip].connect( &(fifos_input[ichip]->in_data) );
         player->out_read[ichip].connect( &(fifos_input[ichip]->in_push_enable) );
         //Input FIFO <-> Boundary finder
@@ -376,33 +765,346 @@ int main(int argc, char* argv[]) {
         evt_builders[ieb]->out_read_data[ichip_per_eb].connect( &(fifos_output_data[ichip]->in_pop_enable) );
         evt_builders[ieb]->out_read_control[ichip_per_eb].connect( &(fifos_output_control[ichip]->in_pop_enable) );
     }
+    if (SIGNAL_PLANE) circuit->use_signal_plane();
+    // the time spent outside the circuit on recording the occupancies (histograms, traces) is profiled as a section
+    int record_occupancy_section = -1;
+    if (PROFILE_PERIOD>0) {
+        circuit->enable_profiling(PROFILE_PERIOD);
+        record_occupancy_section = circuit->get_profiler()->add_section("record_occupancy");
+    }
     
     if (DRY_RUN) {
+        // queueing estimates of the e-link and output link loads, to catch infeasible configurations before simulating them
+        clock_t plan_timer = clock();
+        std::vector<int> ticks_per_word(nchips);
+        for (int ichip=0; ichip<nchips; ichip++) ticks_per_word[ichip] = player->get_ticks_per_word(ichip);
+        CapacityPlanner plan(player->get_event_chip_matrix(), ticks_per_word, eb_assignment, OUTPUT_LINKS, player->get_mean_ticks_per_trigger(), NE>1);
+        std::ofstream os_plan(output_dir+"/capacity_plan.json");
+        plan.write_json(os_plan, chip_basename_list);
+        int max_elink = 0;
+        int max_boundary_finder = 0;
+        for (int ichip=0; ichip<nchips; ichip++) {
+            if (plan.get_elink(ichip).utilization>plan.get_elink(max_elink).utilization) max_elink = ichip;
+            if (plan.get_boundary_finder(ichip).utilization>plan.get_boundary_finder(max_boundary_finder).utilization) max_boundary_finder = ichip;
+        }
+        std::cout<<"highest e-link utilization="<<plan.get_elink(max_elink).utilization<<" ("<<chip_basename_list[max_elink]<<")";
+        std::cout<<", highest boundary finder utilization="<<plan.get_boundary_finder(max_boundary_finder).utilization<<" ("<<chip_basename_list[max_boundary_finder]<<")";
+        std::cout<<", "<<plan.get_overloaded_chips()<<"/"<<nchips<<" chips at or above 100%"<<std::endl;
+        std::cout<<"iEB\t|\toutput link utilization\t|\tmean/p99/p99.99 backlog (words, upper estimate of the output FIFO occupancy)"<<std::endl;
+        for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+            const CapacityPlanner::Queue& builder = plan.get_builder(ieb);
+            std::cout<<ieb<<"\t|\t"<<builder.utilization<<"\t|\t"<<builder.mean_wait<<"/"<<builder.p99_wait<<"/"<<builder.p9999_wait<<std::endl;
+        }
+        std::cout<<"capacity plan written to "<<output_dir<<"/capacity_plan.json in "<<1000.0*(clock()-plan_timer)/CLOCKS_PER_SEC<<" ms"<<std::endl;
+        if (plan.get_overloaded_chips()>0 || plan.get_overloaded_builders()>0) {
+            std::cerr<<"WARNING: infeasible configuration, "<<plan.get_overloaded_chips()<<" chips and "<<plan.get_overloaded_builders()<<" output links are loaded at or above 100%, their queues would grow without bound."<<std::endl;
+        }
         return 0;
     }
 
-    clock_t timer = clock();
+    auto timer = std::chrono::steady_clock::now();
     int inactive_time = 0;
     unsigned long long i_tick = 0;
+    unsigned long long total_skipped_ticks = 0;
     std::vector<int> i_event_per_eb(evt_builders.size(),0);
     int i_event = 0; //technically going to be the min value in i_event_per_eb
     uint16_t global_maximum_input_fifo = 0;
     uint16_t global_maximum_output_fifo_data = 0;
-    // ofstream to store mem usage corresponding to each chip
-    std::vector<std::ofstream> ofstreamvector_output_fifo_data;
-    std::vector<std::ofstream> ofstreamvector_input_fifo;
-    for (int ichip=0; ichip<nchips; ichip++) {
-        string chip_basename = chip_basename_list[ichip];
-        string ichip_output_fname = output_dir+"/output_fifo_data_"+chip_basename+".bin";
-        string ichip_input_fname = output_dir+"/input_fifo_"+chip_basename+".bin";
-        ofstreamvector_output_fifo_data.emplace_back(std::ofstream{ichip_output_fname, std::ios::binary});
-        ofstreamvector_input_fifo.emplace_back(std::ofstream{ichip_input_fname, std::ios::binary});
-        if (!ofstreamvector_output_fifo_data[ichip]) {std::cerr<<"Unable to write to "<<ichip_output_fname<<std::endl; return 4;}
-        if (!ofstreamvector_input_fifo[ichip]) {std::cerr<<"Unable to write to "<<ichip_input_fname<<std::endl; return 4;}
+    // traces of the mem usage corresponding to each chip, only the changes are stored, all in one container file.
+    // The occupancy arrays of the banks are copied every tick and written on a separate thread.
+    std::unique_ptr<AsyncTraceSink> trace_sink;
+    std::string container_fname = output_dir+"/occupancy.dtcq";
+    if (PERIOD==0 && WRITE_TRACES) {
+        trace_sink = std::make_unique<AsyncTraceSink>(std::make_unique<OccupancyContainerWriter>(container_fname, dtc_input.chips, eb_assignment, OUTPUT_LINKS, resume_filename!=""));
+        for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+            std::vector<int> output_columns(nchips_per_eb[ieb]);
+            std::vector<int> input_columns(nchips_per_eb[ieb]);
+            for (int ichip=0; ichip<nchips; ichip++) {
+                if (eb_assignment[ichip]!=ieb) continue;
+                output_columns[ichip_to_ichip_per_eb[ichip]] = OccupancyContainerWriter::column_index(OCCUPANCY_FIFO_OUTPUT_DATA, ichip, nchips);
+                input_columns[ichip_to_ichip_per_eb[ichip]] = OccupancyContainerWriter::column_index(OCCUPANCY_FIFO_INPUT, ichip, nchips);
+            }
+            trace_sink->add_source(fifo_banks_output_data[ieb]->get_occupancies(), output_columns);
+            trace_sink->add_source(fifo_banks_input[ieb]->get_occupancies(), input_columns);
+        }
+        if (!trace_sink->start()) {std::cerr<<"Unable to write to "<<container_fname<<std::endl; return 4;}
     }
     // ofstream to store global maximum within each Period
-    std::ofstream ofstream_period_max_output_fifo_data(output_dir+"/period_max_output_fifo_data.bin", std::ios::binary);
-    std::ofstream ofstream_period_max_input_fifo(output_dir+"/period_max_input_fifo.bin", std::ios::binary);
+    // a resumed run keeps the maxima written up to its checkpoint
+    std::ios::openmode period_max_mode = resume_filename!="" ? std::ios::binary | std::ios::app : std::ios::binary;
+    std::ofstream ofstream_period_max_output_fifo_data(output_dir+"/period_max_output_fifo_data.bin", period_max_mode);
+    std::ofstream ofstream_period_max_input_fifo(output_dir+"/period_max_input_fifo.bin", period_max_mode);
+    // occupancy histograms per chip (lanes of the banks), per event builder and for the whole DTC
+    std::vector<LaneOccupancyHistograms> histograms_input_fifo;
+    std::vector<LaneOccupancyHistograms> histograms_output_fifo_data;
+    for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+        histograms_input_fifo.emplace_back(nchips_per_eb[ieb]);
+        histograms_output_fifo_data.emplace_back(nchips_per_eb[ieb]);
+    }
+    OccupancyHistogram histogram_total_input_fifo;
+    OccupancyHistogram histogram_total_output_fifo_data;
+    // block maxima per chip (lanes of the banks), and of each event builder and the whole DTC (last series)
+    std::vector<BlockMaximaLadder> block_maxima_input_fifo;
+    std::vector<BlockMaximaLadder> block_maxima_output_fifo_data;
+    std::vector<uint32_t> eb_maxima_input_fifo(OUTPUT_LINKS+1);
+    std::vector<uint32_t> eb_maxima_output_fifo_data(OUTPUT_LINKS+1);
+    if (BLOCK_MAXIMA_PERIOD>0) {
+        for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+            block_maxima_input_fifo.emplace_back(nchips_per_eb[ieb], BLOCK_MAXIMA_PERIOD, BLOCK_MAXIMA_LEVELS);
+            block_maxima_output_fifo_data.emplace_back(nchips_per_eb[ieb], BLOCK_MAXIMA_PERIOD, BLOCK_MAXIMA_LEVELS);
+        }
+        block_maxima_input_fifo.emplace_back(OUTPUT_LINKS+1, BLOCK_MAXIMA_PERIOD, BLOCK_MAXIMA_LEVELS);
+        block_maxima_output_fifo_data.emplace_back(OUTPUT_LINKS+1, BLOCK_MAXIMA_PERIOD, BLOCK_MAXIMA_LEVELS);
+    }
+    // batch means of the per-chip p99.9 occupancies and of the DTC maxima for --until-converged,
+    // the counts of a batch are the histograms minus their copies at the start of the batch
+    std::unique_ptr<ConvergenceMonitor> convergence;
+    std::vector<LaneOccupancyHistograms> batch_start_input_fifo;
+    std::vector<LaneOccupancyHistograms> batch_start_output_fifo_data;
+    uint32_t batch_maximum_input_fifo = 0;
+    uint32_t batch_maximum_output_fifo_data = 0;
+    // maxima over the batches, and the batch they last grew in
+    std::vector<uint32_t> running_maxima(2, 0);
+    std::vector<int> growth_batches(2, 0);
+    // the global maxima are not a batch mean: they count as converged once they haven't grown for that many batches
+    const int STABLE_MAXIMUM_BATCHES = 10;
+    if (CONVERGENCE_PRECISION>0) {
+        std::vector<std::string> names;
+        for (int ichip=0; ichip<nchips; ichip++) names.push_back("input_fifo/"+chip_basename_list[ichip]+"/p999");
+        for (int ichip=0; ichip<nchips; ichip++) names.push_back("output_fifo_data/"+chip_basename_list[ichip]+"/p999");
+        names.push_back("input_fifo/max");
+        names.push_back("output_fifo_data/max");
+        convergence = std::make_unique<ConvergenceMonitor>(names, CONVERGENCE_PRECISION);
+        batch_start_input_fifo = histograms_input_fifo;
+        batch_start_output_fifo_data = histograms_output_fifo_data;
+    }
+    auto end_batch = [&]() {
+        std::vector<double> values;
+        for (int ichip=0; ichip<nchips; ichip++) {
+            int ieb = eb_assignment[ichip];
+            values.push_back(histograms_input_fifo[ieb].lane_quantile_since(ichip_to_ichip_per_eb[ichip], 0.999, batch_start_input_fifo[ieb]));
+        }
+        for (int ichip=0; ichip<nchips; ichip++) {
+            int ieb = eb_assignment[ichip];
+            values.push_back(histograms_output_fifo_data[ieb].lane_quantile_since(ichip_to_ichip_per_eb[ichip], 0.999, batch_start_output_fifo_data[ieb]));
+        }
+        values.push_back(batch_maximum_input_fifo);
+        values.push_back(batch_maximum_output_fifo_data);
+        convergence->add_batch(values);
+        uint32_t batch_maxima[2] = {batch_maximum_input_fifo, batch_maximum_output_fifo_data};
+        for (int ififo=0; ififo<2; ififo++) {
+            if (batch_maxima[ififo]<=running_maxima[ififo]) continue;
+            running_maxima[ififo] = batch_maxima[ififo];
+            growth_batches[ififo] = convergence->get_nbatches();
+        }
+        batch_start_input_fifo = histograms_input_fifo;
+        batch_start_output_fifo_data = histograms_output_fifo_data;
+        batch_maximum_input_fifo = 0;
+        batch_maximum_output_fifo_data = 0;
+    };
+    auto batches_converged = [&]() {
+        if (!convergence->converged()) return false;
+        for (int ififo=0; ififo<2; ififo++) {
+            if (convergence->get_nbatches()-growth_batches[ififo]<STABLE_MAXIMUM_BATCHES) return false;
+        }
+        return true;
+    };
+    // record the FIFO occupancies of the last n ticks (up to i_tick), during which the circuit didn't change
+    auto record_occupancy = [&](unsigned long long n) {
+        PROFILE_SECTION(circuit->get_profiler(), 0, record_occupancy_section);
+        uint32_t tick_maximum_input_fifo = 0;
+        uint32_t tick_maximum_output_fifo_data = 0;
+        uint32_t tick_total_input_fifo = 0;
+        uint32_t tick_total_output_fifo_data = 0;
+        for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+            tick_maximum_input_fifo = std::max(tick_maximum_input_fifo, fifo_banks_input[ieb]->get_max_occupancy());
+            tick_maximum_output_fifo_data = std::max(tick_maximum_output_fifo_data, fifo_banks_output_data[ieb]->get_max_occupancy());
+            tick_total_input_fifo += histograms_input_fifo[ieb].record(fifo_banks_input[ieb]->get_occupancies(), fifo_banks_input[ieb]->get_max_occupancy(), n);
+            tick_total_output_fifo_data += histograms_output_fifo_data[ieb].record(fifo_banks_output_data[ieb]->get_occupancies(), fifo_banks_output_data[ieb]->get_max_occupancy(), n);
+        }
+        histogram_total_input_fifo.add(tick_total_input_fifo, n);
+        histogram_total_output_fifo_data.add(tick_total_output_fifo_data, n);
+        batch_maximum_input_fifo = std::max(batch_maximum_input_fifo, tick_maximum_input_fifo);
+        batch_maximum_output_fifo_data = std::max(batch_maximum_output_fifo_data, tick_maximum_output_fifo_data);
+        if (BLOCK_MAXIMA_PERIOD>0) {
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                block_maxima_input_fifo[ieb].record(fifo_banks_input[ieb]->get_occupancies(), n);
+                block_maxima_output_fifo_data[ieb].record(fifo_banks_output_data[ieb]->get_occupancies(), n);
+                eb_maxima_input_fifo[ieb] = fifo_banks_input[ieb]->get_max_occupancy();
+                eb_maxima_output_fifo_data[ieb] = fifo_banks_output_data[ieb]->get_max_occupancy();
+            }
+            eb_maxima_input_fifo[OUTPUT_LINKS] = tick_maximum_input_fifo;
+            eb_maxima_output_fifo_data[OUTPUT_LINKS] = tick_maximum_output_fifo_data;
+            block_maxima_input_fifo[OUTPUT_LINKS].record(eb_maxima_input_fifo.data(), n);
+            block_maxima_output_fifo_data[OUTPUT_LINKS].record(eb_maxima_output_fifo_data.data(), n);
+        }
+        assert( tick_maximum_input_fifo <= std::numeric_limits<uint16_t>::max() );
+        assert( tick_maximum_output_fifo_data <= std::numeric_limits<uint16_t>::max() );
+        if (PERIOD==0 && WRITE_TRACES) {
+            trace_sink->record(n);
+        }
+        if (PERIOD>0) {
+            unsigned long long first_tick = i_tick - n + 1;
+            unsigned long long period_end = (first_tick + PERIOD - 1) / PERIOD * PERIOD; // first multiple of PERIOD in range
+            // ticks before the first period boundary still belong to the running period
+            if (period_end > first_tick) {
+                global_maximum_output_fifo_data = std::max(global_maximum_output_fifo_data, (uint16_t) tick_maximum_output_fifo_data);
+                global_maximum_input_fifo = std::max(global_maximum_input_fifo, (uint16_t) tick_maximum_input_fifo);
+            }
+            for (; period_end<=i_tick; period_end+=PERIOD) {
+                ofstream_period_max_output_fifo_data.write(reinterpret_cast<const char*>(&global_maximum_output_fifo_data), sizeof(global_maximum_output_fifo_data) );
+                std::cout<<"current output FIFO global maximum = "<<global_maximum_output_fifo_data<<std::endl;
+                ofstream_period_max_input_fifo.write(reinterpret_cast<const char*>(&global_maximum_input_fifo), sizeof(global_maximum_input_fifo) );
+                global_maximum_input_fifo = 0;
+                global_maximum_output_fifo_data = 0;
+            }
+        }
+        global_maximum_output_fifo_data = std::max(global_maximum_output_fifo_data, (uint16_t) tick_maximum_output_fifo_data);
+        global_maximum_input_fifo = std::max(global_maximum_input_fifo, (uint16_t) tick_maximum_input_fifo);
+    };
+    // checkpoints: the state of the circuit and of this loop, the histograms, the length of the period maxima files and the state of the occupancy container.
+    // The key holds the options the state depends on, a checkpoint is only resumed by the same run.
+    static const char checkpoint_magic[8] = {'D','T','C','Q','C','K','P','T'};
+    static const uint32_t checkpoint_version = 5;
+    std::string checkpoint_fname = output_dir+"/checkpoint.bin";
+    std::string checkpoint_key = output_dir+" block-maxima "+to_string(BLOCK_MAXIMA_PERIOD)+"x"+to_string(BLOCK_MAXIMA_LEVELS);
+    if (trace_sink) checkpoint_key += " traces";
+    if (convergence) checkpoint_key += " until-converged "+to_string(CONVERGENCE_PRECISION)+" batch "+to_string(BATCH_TICKS);
+    double resumed_seconds = 0; // simulation time before the checkpoint resumed
+    auto write_checkpoint_state = [&](StateWriter& out) {
+        ofstream_period_max_output_fifo_data.flush();
+        ofstream_period_max_input_fifo.flush();
+        out.write<uint64_t>(ofstream_period_max_output_fifo_data.tellp());
+        out.write<uint64_t>(ofstream_period_max_input_fifo.tellp());
+        out.write(resumed_seconds + seconds_since(timer));
+        out.write(i_tick);
+        out.write(total_skipped_ticks);
+        out.write(i_event_per_eb);
+        out.write(i_event);
+        out.write(global_maximum_input_fifo);
+        out.write(global_maximum_output_fifo_data);
+        circuit->save_state(out);
+        if (trace_sink) trace_sink->save_state(out);
+        for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+            histograms_input_fifo[ieb].save_state(out);
+            histograms_output_fifo_data[ieb].save_state(out);
+        }
+        histogram_total_input_fifo.save_state(out);
+        histogram_total_output_fifo_data.save_state(out);
+        for (auto& ladder : block_maxima_input_fifo) ladder.save_state(out);
+        for (auto& ladder : block_maxima_output_fifo_data) ladder.save_state(out);
+        if (convergence) {
+            convergence->save_state(out);
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                batch_start_input_fifo[ieb].save_state(out);
+                batch_start_output_fifo_data[ieb].save_state(out);
+            }
+            out.write(batch_maximum_input_fifo);
+            out.write(batch_maximum_output_fifo_data);
+            out.write(running_maxima);
+            out.write(growth_batches);
+        }
+    };
+    // written next to the previous checkpoint and renamed over it, so a run stopped while writing keeps the previous one
+    auto save_checkpoint = [&]() {
+        std::string tmp_fname = checkpoint_fname+".tmp";
+        std::ofstream os_checkpoint(tmp_fname, std::ios::binary);
+        StateWriter out(os_checkpoint);
+        os_checkpoint.write(checkpoint_magic, sizeof(checkpoint_magic));
+        out.write(checkpoint_version);
+        out.write(checkpoint_key);
+        write_checkpoint_state(out);
+        os_checkpoint.close();
+        if (!os_checkpoint) return false;
+        return std::rename(tmp_fname.c_str(), checkpoint_fname.c_str())==0;
+    };
+    if (resume_filename!="") {
+        std::ifstream is_checkpoint(resume_filename, std::ios::binary);
+        if (!is_checkpoint) {std::cerr<<"Unable to read "<<resume_filename<<std::endl; return 4;}
+        StateReader in(is_checkpoint);
+        try {
+            char magic[sizeof(checkpoint_magic)];
+            is_checkpoint.read(magic, sizeof(magic));
+            if (!is_checkpoint || !std::equal(magic, magic+sizeof(magic), checkpoint_magic)) throw std::runtime_error("not a dtc checkpoint");
+            if (in.read<uint32_t>()!=checkpoint_version) throw std::runtime_error("checkpoint of another version of dtc");
+            if (in.read<std::string>()!=checkpoint_key) throw std::runtime_error("checkpoint of a run with other options or input, expected "+checkpoint_key);
+            uint64_t period_max_output_fifo_data_bytes = in.read<uint64_t>();
+            uint64_t period_max_input_fifo_bytes = in.read<uint64_t>();
+            in.read(resumed_seconds);
+            in.read(i_tick);
+            in.read(total_skipped_ticks);
+            in.read(i_event_per_eb);
+            in.read(i_event);
+            in.read(global_maximum_input_fifo);
+            in.read(global_maximum_output_fifo_data);
+            circuit->load_state(in);
+            if (trace_sink) trace_sink->load_state(in);
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                histograms_input_fifo[ieb].load_state(in);
+                histograms_output_fifo_data[ieb].load_state(in);
+            }
+            histogram_total_input_fifo.load_state(in);
+            histogram_total_output_fifo_data.load_state(in);
+            for (auto& ladder : block_maxima_input_fifo) ladder.load_state(in);
+            for (auto& ladder : block_maxima_output_fifo_data) ladder.load_state(in);
+            if (convergence) {
+                convergence->load_state(in);
+                for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                    batch_start_input_fifo[ieb].load_state(in);
+                    batch_start_output_fifo_data[ieb].load_state(in);
+                }
+                in.read(batch_maximum_input_fifo);
+                in.read(batch_maximum_output_fifo_data);
+                in.read(running_maxima);
+                in.read(growth_batches);
+            }
+            // the period maxima written after the checkpoint are dropped, the run appends from the checkpoint on
+            ofstream_period_max_output_fifo_data.close();
+            ofstream_period_max_input_fifo.close();
+            if (boost::filesystem::file_size(output_dir+"/period_max_output_fifo_data.bin")<period_max_output_fifo_data_bytes ||
+                boost::filesystem::file_size(output_dir+"/period_max_input_fifo.bin")<period_max_input_fifo_bytes) {
+                throw std::runtime_error("the period maxima files are shorter than at the checkpoint");
+            }
+            boost::filesystem::resize_file(output_dir+"/period_max_output_fifo_data.bin", period_max_output_fifo_data_bytes);
+            boost::filesystem::resize_file(output_dir+"/period_max_input_fifo.bin", period_max_input_fifo_bytes);
+            ofstream_period_max_output_fifo_data.open(output_dir+"/period_max_output_fifo_data.bin", period_max_mode);
+            ofstream_period_max_input_fifo.open(output_dir+"/period_max_input_fifo.bin", period_max_mode);
+        }
+        catch (const std::exception& e) {
+            std::cerr<<"Unable to resume from "<<resume_filename<<": "<<e.what()<<std::endl;
+            return 4;
+        }
+        std::cout<<"resumed from "<<resume_filename<<" at tick "<<i_tick<<" with "<<i_event<<"/"<<nevents<<" events built"<<std::endl;
+    }
+    unsigned long long next_checkpoint_tick = CHECKPOINT_EVERY>0 ? (i_tick/CHECKPOINT_EVERY+1)*CHECKPOINT_EVERY : 0;
+    // the batches end at the multiples of BATCH_TICKS
+    unsigned long long next_batch_tick = (i_tick/BATCH_TICKS+1)*BATCH_TICKS;
+    // record the FIFO occupancies of the last n ticks (up to i_tick), split at the batch ends among them so that every batch holds exactly
+    // BATCH_TICKS ticks. Once converged at a batch end, the ticks after it are left out and i_tick is moved back to it, returns false.
+    auto record_batches = [&](unsigned long long n) {
+        unsigned long long last_tick = i_tick;
+        unsigned long long recorded_tick = i_tick - n;
+        while (convergence && next_batch_tick<=last_tick) {
+            i_tick = next_batch_tick;
+            record_occupancy(i_tick - recorded_tick);
+            recorded_tick = i_tick;
+            end_batch();
+            next_batch_tick += BATCH_TICKS;
+            if (batches_converged()) return false;
+        }
+        i_tick = last_tick;
+        if (last_tick>recorded_tick) record_occupancy(last_tick - recorded_tick);
+        return true;
+    };
+    // rare occupancy levels, estimated from clones of the run at each crossing of the first level
+    std::unique_ptr<OverflowSplitting> splitting;
+    const std::vector<std::shared_ptr<FIFOBank64>>& splitting_banks = SPLITTING_INPUT_FIFO ? fifo_banks_input : fifo_banks_output_data;
+    auto splitting_occupancy = [&]() {
+        uint32_t occupancy = 0;
+        for (auto bank : splitting_banks) occupancy = std::max(occupancy, bank->get_max_occupancy());
+        return occupancy;
+    };
+    if (SPLITTING_LEVELS.size()>0) splitting = std::make_unique<OverflowSplitting>(circuit, player, splitting_occupancy, SPLITTING_LEVELS, SPLITTING_FACTOR, SEED);
     std::cout<<"auto-ticking..."<<std::endl;
     while (true)
     {
@@ -470,27 +1172,8 @@ int main(int argc, char* argv[]) {
         i_tick++;
         //std::cout<<"tick="<<i_tick<<std::endl;
         circuit->tick();
-        if (PERIOD>0 && i_tick%PERIOD==0) {
-            ofstream_period_max_output_fifo_data.write(reinterpret_cast<const char*>(&global_maximum_output_fifo_data), sizeof(global_maximum_output_fifo_data) );
-            std::cout<<"current output FIFO global maximum = "<<global_maximum_output_fifo_data<<std::endl;
-            ofstream_period_max_input_fifo.write(reinterpret_cast<const char*>(&global_maximum_input_fifo), sizeof(global_maximum_input_fifo) );
-            global_maximum_input_fifo = 0;
-            global_maximum_output_fifo_data = 0;
-        }
-        for (int ichip=0; ichip<nchips; ichip++) {
-            int value = fifos_output_data[ichip]->d_get_buffer_size();
-            assert( (value >= std::numeric_limits<uint16_t>::min()) && (value <= std::numeric_limits<uint16_t>::max()) );
-            uint16_t shortened_value = (uint16_t) value;
-            global_maximum_output_fifo_data = std::max(global_maximum_output_fifo_data, shortened_value);
-            if (PERIOD==0) 
-                ofstreamvector_output_fifo_data[ichip].write(reinterpret_cast<const char*>(&shortened_value), sizeof(shortened_value) );
-            value = fifos_input[ichip]->d_get_buffer_size();
-            assert( (value >= std::numeric_limits<uint16_t>::min()) && (value <= std::numeric_limits<uint16_t>::max()) );
-            shortened_value = (uint16_t) value;
-            global_maximum_input_fifo = std::max(global_maximum_input_fifo, shortened_value);
-            if (PERIOD==0) 
-                ofstreamvector_input_fifo[ichip].write(reinterpret_cast<const char*>(&shortened_value), sizeof(shortened_value) );
-        };
+        bool converged = !record_batches(1);
+        if (splitting) splitting->observe(splitting_occupancy());
         for (int ieb=0; ieb<evt_builders.size(); ieb++) if (evt_builders[ieb]->out_event_ready.get_value()) {
             i_event_per_eb[ieb]++;
         }
@@ -515,14 +1198,186 @@ int main(int argc, char* argv[]) {
             std::cout.flush();
             if (i_event>=nevents) break;
         }
+        if (FAST_FORWARD && !DEBUG && !converged) {
+            unsigned long long skipped_ticks = circuit->fast_forward();
+            if (skipped_ticks>0) {
+                unsigned long long skip_start = i_tick;
+                i_tick += skipped_ticks;
+                converged = !record_batches(skipped_ticks);
+                total_skipped_ticks += i_tick - skip_start;
+            }
+        }
+        if (converged) break;
+        if (CHECKPOINT_EVERY>0 && i_tick>=next_checkpoint_tick) {
+            if (!save_checkpoint()) {std::cerr<<"Unable to write to "<<checkpoint_fname<<std::endl; return 4;}
+            next_checkpoint_tick = (i_tick/CHECKPOINT_EVERY+1)*CHECKPOINT_EVERY;
+        }
     }
-    timer = clock() - timer;
-    double seconds = ((double) timer) / CLOCKS_PER_SEC;
+    double seconds = resumed_seconds + seconds_since(timer);
     std::cout<<std::endl<<"total ticks="<<i_tick<<endl;
+    if (FAST_FORWARD) std::cout<<"fast-forwarded ticks="<<total_skipped_ticks<<std::endl;
+    if (trace_sink) {
+        if (!trace_sink->close()) {std::cerr<<"Unable to write to "<<container_fname<<std::endl; return 4;}
+        if (trace_sink->get_stalls()>0) std::cout<<"trace writer backpressure: simulation waited "<<trace_sink->get_stall_seconds()<<" seconds for the disk in "<<trace_sink->get_stalls()<<" stalls"<<std::endl;
+    }
+    if (RANDOM_L1) {
+        unsigned long long potential_triggers = player->get_potential_trigger_counts();
+        unsigned long long blocked_triggers = player->get_blocked_trigger_counts();
+        std::cout<<"blocked triggers according to trigger rule="<<blocked_triggers<<"/"<<potential_triggers<<" ("<<(potential_triggers>0 ? 100.0*blocked_triggers/potential_triggers : 0.0)<<"%)"<<std::endl;
+    }
     std::cout<<"simulation running time="<<seconds<<" seconds"<<std::endl;
     std::cout<<"simulation frequency="<<1.0*i_tick/seconds<<" HZ"<<std::endl;
     if (PERIOD==0) {
         std::cout<<"input FIFO global maximum ="<<int(global_maximum_input_fifo)<<std::endl;
         std::cout<<"output FIFO (data) global maximum ="<<int(global_maximum_output_fifo_data)<<std::endl;
     }
+    if (circuit->get_profiler()) {
+        std::ofstream os_profile(output_dir+"/profile.json");
+        circuit->get_profiler()->write_json(os_profile);
+        std::cout<<"profile of every "<<PROFILE_PERIOD<<"-th tick written to "<<output_dir<<"/profile.json"<<std::endl;
+    }
+    // counters of the run: e-link utilization, event builder link and stall fractions, parsing halts and FIFO high-water marks
+    std::ofstream os_stats(output_dir+"/run_stats.json");
+    auto fraction = [&](unsigned long long ticks) {return i_tick>0 ? 1.0*ticks/i_tick : 0.0;};
+    os_stats<<"{\"nticks\": "<<i_tick<<", \"fast_forwarded_ticks\": "<<total_skipped_ticks<<", \"seconds\": "<<seconds<<", \"frequency\": "<<(seconds>0 ? 1.0*i_tick/seconds : 0.0)<<",\n";
+    os_stats<<"\"triggers\": {\"issued\": "<<player->get_triggered_events()<<", \"potential\": "<<player->get_potential_trigger_counts()<<", \"blocked\": "<<player->get_blocked_trigger_counts()<<"},\n";
+    if (trace_sink) os_stats<<"\"trace_writer\": {\"stalls\": "<<trace_sink->get_stalls()<<", \"stall_seconds\": "<<trace_sink->get_stall_seconds()<<"},\n";
+    // high-water marks of a single FIFO (the global maxima), and of the occupancy summed over the chips
+    uint32_t high_water_input_fifo = 0;
+    uint32_t high_water_output_fifo_data = 0;
+    for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+        high_water_input_fifo = std::max(high_water_input_fifo, histograms_input_fifo[ieb].get_max_lane_occupancy());
+        high_water_output_fifo_data = std::max(high_water_output_fifo_data, histograms_output_fifo_data[ieb].get_max_lane_occupancy());
+    }
+    os_stats<<"\"fifo_high_water\": {\"input_fifo\": "<<high_water_input_fifo<<", \"output_fifo_data\": "<<high_water_output_fifo_data<<"},\n";
+    os_stats<<"\"dtc_sum_high_water\": {\"input_fifo\": "<<histogram_total_input_fifo.get_max()<<", \"output_fifo_data\": "<<histogram_total_output_fifo_data.get_max()<<"},\n";
+    os_stats<<"\"event_builders\": [";
+    for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+        os_stats<<(ieb>0 ? ",\n    " : "\n    ");
+        os_stats<<"{\"nchips\": "<<nchips_per_eb[ieb]<<", \"events\": "<<evt_builders[ieb]->get_events_built();
+        os_stats<<", \"link_busy_fraction\": "<<fraction(evt_builders[ieb]->get_link_busy_ticks());
+        os_stats<<", \"wait_slowest_chip_fraction\": "<<fraction(evt_builders[ieb]->get_wait_ticks());
+        os_stats<<", \"link_blocked_fraction\": "<<fraction(evt_builders[ieb]->get_link_blocked_ticks());
+        os_stats<<", \"input_fifo_high_water\": "<<histograms_input_fifo[ieb].get_max_lane_occupancy();
+        os_stats<<", \"output_fifo_data_high_water\": "<<histograms_output_fifo_data[ieb].get_max_lane_occupancy();
+        os_stats<<", \"input_fifo_sum_high_water\": "<<histograms_input_fifo[ieb].get_sum_histogram().get_max();
+        os_stats<<", \"output_fifo_data_sum_high_water\": "<<histograms_output_fifo_data[ieb].get_sum_histogram().get_max()<<"}";
+    }
+    os_stats<<"],\n\"chips\": {";
+    for (int ichip=0; ichip<nchips; ichip++) {
+        int ieb = eb_assignment[ichip];
+        double elink_utilization = fraction(player->get_words_sent(ichip)*player->get_ticks_per_word(ichip));
+        os_stats<<(ichip>0 ? ",\n    " : "\n    ")<<"\""<<chip_basename_list[ichip]<<"\": ";
+        os_stats<<"{\"eb\": "<<ieb<<", \"words\": "<<player->get_words_sent(ichip)<<", \"ticks_per_word\": "<<player->get_ticks_per_word(ichip);
+        os_stats<<", \"elink_utilization\": "<<elink_utilization<<", \"elink_idle_fraction\": "<<1-elink_utilization;
+        os_stats<<", \"ebf_halt_fraction\": "<<fraction(ebfs[ichip]->get_halt_ticks());
+        os_stats<<", \"input_fifo_high_water\": "<<histograms_input_fifo[ieb].lane_histogram(ichip_to_ichip_per_eb[ichip]).get_max();
+        os_stats<<", \"output_fifo_data_high_water\": "<<histograms_output_fifo_data[ieb].lane_histogram(ichip_to_ichip_per_eb[ichip]).get_max()<<"}";
+    }
+    os_stats<<"}}"<<std::endl;
+    write_occupancy_summary(i_tick, histograms_input_fifo, histogram_total_input_fifo, histograms_output_fifo_data, histogram_total_output_fifo_data);
+    // block maxima ladders, read by plot/eva.py instead of period_max_*.bin; the medians (p50) are the inputs of the fit
+    if (BLOCK_MAXIMA_PERIOD>0) {
+        std::ofstream os_block_maxima(output_dir+"/block_maxima.json");
+        auto write_fifo_block_maxima = [&](std::string fifo_name, const std::vector<BlockMaximaLadder>& ladders) {
+            os_block_maxima<<"\""<<fifo_name<<"\": {\n    \"total\": ";
+            ladders[OUTPUT_LINKS].write_json(os_block_maxima, OUTPUT_LINKS);
+            os_block_maxima<<",\n    \"event_builders\": [";
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                os_block_maxima<<(ieb>0 ? ",\n        " : "\n        ");
+                ladders[OUTPUT_LINKS].write_json(os_block_maxima, ieb);
+            }
+            os_block_maxima<<"],\n    \"chips\": {";
+            for (int ichip=0; ichip<nchips; ichip++) {
+                os_block_maxima<<(ichip>0 ? ",\n        " : "\n        ")<<"\""<<chip_basename_list[ichip]<<"\": ";
+                ladders[eb_assignment[ichip]].write_json(os_block_maxima, ichip_to_ichip_per_eb[ichip]);
+            }
+            os_block_maxima<<"}}";
+        };
+        os_block_maxima<<"{\"nticks\": "<<i_tick<<", \"base_period\": "<<BLOCK_MAXIMA_PERIOD<<",\n";
+        write_fifo_block_maxima("input_fifo", block_maxima_input_fifo);
+        os_block_maxima<<",\n";
+        write_fifo_block_maxima("output_fifo_data", block_maxima_output_fifo_data);
+        os_block_maxima<<"}"<<std::endl;
+    }
+    if (convergence) {
+        std::ofstream os_convergence(output_dir+"/convergence.json");
+        os_convergence<<"{\"nevents\": "<<i_event<<", \"max_nevents\": "<<nevents<<", \"nticks\": "<<i_tick<<", \"batch_ticks\": "<<BATCH_TICKS<<",\n";
+        os_convergence<<"\"global_maximum\": {\"input_fifo\": {\"max\": "<<running_maxima[0]<<", \"last_growth_batch\": "<<growth_batches[0]<<"}, ";
+        os_convergence<<"\"output_fifo_data\": {\"max\": "<<running_maxima[1]<<", \"last_growth_batch\": "<<growth_batches[1]<<"}, ";
+        os_convergence<<"\"stable_batches\": "<<STABLE_MAXIMUM_BATCHES<<"},\n\"converged\": "<<(batches_converged() ? "true" : "false")<<",\n\"monitor\": ";
+        convergence->write_json(os_convergence);
+        os_convergence<<"}"<<std::endl;
+        int worst = convergence->get_worst_series();
+        std::cout<<"until-converged: "<<(batches_converged() ? "reached" : "did not reach")<<" the relative precision "<<CONVERGENCE_PRECISION;
+        std::cout<<" with "<<i_event<<" events ("<<convergence->get_nbatches()<<" batches of "<<BATCH_TICKS<<" ticks), achieved "<<convergence->get_relative_half_width(worst);
+        std::cout<<" on "<<convergence->get_name(worst)<<std::endl;
+        std::cout<<"global maximum input FIFO="<<running_maxima[0]<<" last grew in batch "<<growth_batches[0];
+        std::cout<<", output FIFO (data)="<<running_maxima[1]<<" last grew in batch "<<growth_batches[1]<<std::endl;
+        if (!batches_converged()) std::cerr<<"WARNING: the occupancy statistics haven't converged within "<<nevents<<" events, see "<<output_dir<<"/convergence.json"<<std::endl;
+    }
+    if (splitting) {
+        std::ofstream os_splitting(output_dir+"/splitting.json");
+        os_splitting<<"{\"fifo\": \""<<(SPLITTING_INPUT_FIFO ? "input_fifo" : "output_fifo_data")<<"\", \"estimate\": ";
+        splitting->write_json(os_splitting, i_tick, clock_frequency);
+        os_splitting<<"}"<<std::endl;
+        std::cout<<"multilevel splitting of the "<<(SPLITTING_INPUT_FIFO ? "input" : "output data")<<" FIFO occupancy, "<<splitting->get_crossings()<<" crossings of the first level";
+        if (splitting->get_truncated_trials()>0) std::cout<<", "<<splitting->get_truncated_trials()<<" trajectories truncated after "<<OverflowSplitting::max_trial_ticks<<" ticks";
+        std::cout<<std::endl;
+        std::cout<<std::setw(10)<<"words"<<std::setw(10)<<"kb"<<std::setw(14)<<"P(next|this)"<<std::setw(14)<<"rate [1/s]"<<std::setw(14)<<"+-95%"<<std::setw(16)<<"interval [s]"<<std::endl;
+        for (int ilevel=0; ilevel<splitting->get_nlevels(); ilevel++) {
+            const OverflowSplitting::Level& level = splitting->get_level(ilevel);
+            const OverflowSplitting::Level* next = ilevel+1<splitting->get_nlevels() ? &splitting->get_level(ilevel+1) : nullptr;
+            double rate = splitting->get_rate(ilevel, i_tick)*clock_frequency;
+            std::cout<<std::setw(10)<<level.occupancy<<std::setw(10)<<level.occupancy*64/1000.0;
+            if (next && next->trials>0) std::cout<<std::setw(14)<<1.0*next->successes/next->trials;
+            else std::cout<<std::setw(14)<<"-";
+            std::cout<<std::setw(14)<<rate<<std::setw(14)<<splitting->get_rate_error(ilevel, i_tick)*clock_frequency;
+            if (rate>0) std::cout<<std::setw(16)<<1/rate<<std::endl;
+            else std::cout<<std::setw(16)<<"-"<<std::endl;
+        }
+    }
+    // distances between the occupancy distributions of the two engines, the largest one is held against the tolerance
+    if (event_engine) {
+        double max_distance = 0;
+        double nticks_difference = i_tick>0 ? std::fabs(1.0*event_engine_nticks - i_tick)/i_tick : 0.0;
+        std::ofstream os_cross_validation(output_dir+"/cross_validation.json");
+        auto write_distance = [&](const OccupancyHistogram& tick_histogram, const OccupancyHistogram& event_histogram) {
+            double distance = tick_histogram.distance(event_histogram);
+            max_distance = std::max(max_distance, distance);
+            os_cross_validation<<distance;
+        };
+        auto write_fifo_distances = [&](std::string fifo_name, OccupancyFIFO ififo, const std::vector<LaneOccupancyHistograms>& histograms, const OccupancyHistogram& total) {
+            const std::vector<LaneOccupancyHistograms>& event_histograms = event_engine->get_histograms(ififo);
+            os_cross_validation<<"\""<<fifo_name<<"\": {\n    \"total\": ";
+            write_distance(total, event_engine->get_total_histogram(ififo));
+            os_cross_validation<<",\n    \"event_builders\": [";
+            for (int ieb=0; ieb<OUTPUT_LINKS; ieb++) {
+                os_cross_validation<<(ieb>0 ? ", " : "");
+                write_distance(histograms[ieb].get_sum_histogram(), event_histograms[ieb].get_sum_histogram());
+            }
+            os_cross_validation<<"],\n    \"chips\": {";
+            for (int ichip=0; ichip<nchips; ichip++) {
+                int ieb = eb_assignment[ichip];
+                os_cross_validation<<(ichip>0 ? ",\n        " : "\n        ")<<"\""<<chip_basename_list[ichip]<<"\": ";
+                write_distance(histograms[ieb].lane_histogram(ichip_to_ichip_per_eb[ichip]), event_histograms[ieb].lane_histogram(ichip_to_ichip_per_eb[ichip]));
+            }
+            os_cross_validation<<"}}";
+        };
+        os_cross_validation<<"{\"nticks\": {\"tick\": "<<i_tick<<", \"event\": "<<event_engine_nticks<<", \"relative_difference\": "<<nticks_difference<<"},\n";
+        os_cross_validation<<"\"seconds\": {\"tick\": "<<seconds<<", \"event\": "<<event_engine_seconds<<"}, \"speedup\": "<<(event_engine_seconds>0 ? seconds/event_engine_seconds : 0.0)<<",\n";
+        write_fifo_distances("input_fifo", OCCUPANCY_FIFO_INPUT, histograms_input_fifo, histogram_total_input_fifo);
+        os_cross_validation<<",\n";
+        write_fifo_distances("output_fifo_data", OCCUPANCY_FIFO_OUTPUT_DATA, histograms_output_fifo_data, histogram_total_output_fifo_data);
+        bool passed = max_distance<=EventLevelEngine::occupancy_tolerance && nticks_difference<=EventLevelEngine::nticks_tolerance;
+        os_cross_validation<<",\n\"max_distance\": "<<max_distance<<", \"occupancy_tolerance\": "<<EventLevelEngine::occupancy_tolerance;
+        os_cross_validation<<", \"nticks_tolerance\": "<<EventLevelEngine::nticks_tolerance<<", \"passed\": "<<(passed ? "true" : "false")<<"}"<<std::endl;
+        std::cout<<"cross-validation: largest occupancy distance="<<max_distance<<" (tolerance "<<EventLevelEngine::occupancy_tolerance<<")";
+        std::cout<<", relative nticks difference="<<nticks_difference<<" (tolerance "<<EventLevelEngine::nticks_tolerance<<")";
+        std::cout<<", event-level engine "<<(event_engine_seconds>0 ? seconds/event_engine_seconds : 0.0)<<"x faster"<<std::endl;
+        if (!passed) {
+            std::cerr<<"the event-level engine is outside the tolerances, see "<<output_dir<<"/cross_validation.json"<<std::endl;
+            return 5;
+        }
+    }
 }
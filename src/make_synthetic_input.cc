@@ -0,0 +1,120 @@
+#include <interface/ChipConfigReader.h>
+#include <interface/EventSizeCache.h>
+#include <boost/filesystem.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+using namespace std;
+
+// Write an input directory with a synthetic event size cache for one DTC, without any chiptrees.root:
+// the chips of the DTC in the config, with exponentially distributed stream sizes of the average size of the config.
+// Used to run dtc end to end (e.g. --cross-validate) where the simulated input is not available.
+int main(int argc, char* argv[]) {
+    std::string output_dirname("input_synthetic");
+    std::string config_file_name("config/default.config");
+    int dtc_number = 14;
+    int nevents = 2000;
+    uint64_t SEED = 233;
+    std::string help_msg("Usage: ./build/make_synthetic_input [options]\n\
+            --help:                         display this message.\n\
+            --output/-o OUTPUT_DIRNAME:     input directory to write, the cache is written there as chiptrees.dtcq. Default value = input_synthetic.\n\
+            --config/-c CONFIG_FILENAME:    Config file with the chips and their average sizes, by default uses config/default.config.\n\
+            --dtc/-d DTC:                   DTC number whose chips are written. Default value = 14.\n\
+            --nevents/-n N_Events:          Number of input events. Default value = 2000.\n\
+            --seed SEED:                    seed of the stream sizes. Default value = 233.\n");
+    for (int iarg =0; iarg<argc; iarg++) {
+        if (iarg==0) continue;
+        if (std::string(argv[iarg])=="--help") {std::cerr<<help_msg<<std::endl; return 0;}
+        if (std::string(argv[iarg])=="--output" || std::string(argv[iarg])=="-o") {
+            if (iarg+1 < argc) {
+                output_dirname = argv[++iarg];
+            }
+            else {
+                std::cerr<<"--output/-o option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--config" || std::string(argv[iarg])=="-c") {
+            if (iarg+1 < argc) {
+                config_file_name = argv[++iarg];
+            }
+            else {
+                std::cerr<<"--config/-c option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--dtc" || std::string(argv[iarg])=="-d") {
+            if (iarg+1 < argc) {
+                std::string dtc_str(argv[++iarg]);
+                dtc_number = stoi(dtc_str);
+            }
+            else {
+                std::cerr<<"--dtc/-d option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--nevents" || std::string(argv[iarg])=="-n") {
+            if (iarg+1 < argc) {
+                std::string nevents_str(argv[++iarg]);
+                nevents = stoi(nevents_str);
+            }
+            else {
+                std::cerr<<"--nevents/-n option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::string(argv[iarg])=="--seed") {
+            if (iarg+1 < argc) {
+                std::string seed_str(argv[++iarg]);
+                SEED = stoull(seed_str);
+            }
+            else {
+                std::cerr<<"--seed option requires one argument."<<std::endl;
+                return 1;
+            }
+            continue;
+        }
+        std::cerr<<"Unknow option/argument: "<<argv[iarg]<<std::endl;
+        return 2;
+    }
+
+    ChipConfigReader config(config_file_name);
+    DTCInput input;
+    std::vector<float> average_sizes;
+    for (const std::string& basename : config.ordered_basenames) {
+        ChipInfo chip_info;
+        if (std::sscanf(basename.c_str(), "dtc%disBarrel%dlayer%ddisk%dmodule%dchip%d", &chip_info.dtc, &chip_info.barrel, &chip_info.layer,
+                        &chip_info.disk, &chip_info.module_id, &chip_info.chip)!=6) continue;
+        if (chip_info.dtc!=dtc_number) continue;
+        chip_info.tree_module = chip_info.module_id;
+        input.chips.push_back(chip_info);
+        average_sizes.push_back(config.GetAvgSize(basename));
+    }
+    if (input.chips.empty()) {std::cerr<<"No chip of DTC "<<dtc_number<<" in "<<config_file_name<<std::endl; return 3;}
+
+    // at least one word per chip and event, the parsing time taken as half the size
+    int nchips = input.chips.size();
+    input.event_chip_matrix = std::make_shared<EventChipMatrix>(nevents, nchips);
+    std::mt19937_64 rng(SEED);
+    for (int ichip=0; ichip<nchips; ichip++) {
+        std::exponential_distribution<double> size_distribution(1.0/std::max(average_sizes[ichip]-1, 0.1f));
+        for (int ievent=0; ievent<nevents; ievent++) {
+            unsigned short size = 1 + (unsigned short) std::min(size_distribution(rng), 1000.0);
+            input.event_chip_matrix->at(ievent, ichip) = {size, (unsigned short) (size/2+1)};
+        }
+    }
+
+    std::string dtcname = "dtc"+std::to_string(dtc_number);
+    boost::filesystem::create_directories(output_dirname);
+    std::string cache_file_name = output_dirname + "/chiptrees.dtcq";
+    std::cout<<"Writing "<<nevents<<" synthetic events of "<<nchips<<" chips of "<<dtcname<<" into "<<cache_file_name<<std::endl;
+    EventSizeCache::write(cache_file_name, "", {dtcname}, [&input](std::string) {return input;});
+    return 0;
+}
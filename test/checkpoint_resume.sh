@@ -0,0 +1,30 @@
+#!/bin/bash
+# Kill a dtc run once it wrote its first checkpoint, resume it, and check that its outputs are the same as those of an uninterrupted run.
+# Usage: test/checkpoint_resume.sh DTC_EXECUTABLE INPUT_DIRNAME CONFIG_FILENAME [more dtc options, e.g. --block-maxima 1000]
+set -e
+dtc=$1
+input=$2
+config=$3
+shift 3
+args="-i $input -c $config -d 14 -n 3000 $*"
+checkpoint_every=200000
+
+# the outputs of earlier runs are removed first, the dry run only tells the output dir
+ref_dir=$($dtc $args -t ref --dry-run | sed -n 's/.*Output dir=//p')
+resume_dir=${ref_dir/_ref_/_resume_}
+rm -rf "$ref_dir" "$resume_dir"
+$dtc $args -t ref > ref.log 2>&1
+
+$dtc $args -t resume --checkpoint-every $checkpoint_every > resume.log 2>&1 &
+pid=$!
+while [ ! -f "$resume_dir/checkpoint.bin" ] && kill -0 $pid 2>/dev/null; do sleep 0.1; done
+kill -9 $pid 2>/dev/null || true
+wait $pid || true
+if [ ! -f "$resume_dir/checkpoint.bin" ]; then echo "no checkpoint written, see resume.log"; exit 1; fi
+
+$dtc $args -t resume --checkpoint-every $checkpoint_every --resume "$resume_dir/checkpoint.bin" >> resume.log 2>&1
+for output in occupancy_summary.json occupancy.dtcq block_maxima.json convergence.json; do
+    if [ ! -f "$ref_dir/$output" ]; then continue; fi
+    if ! cmp "$ref_dir/$output" "$resume_dir/$output"; then echo "$output differs after resuming"; exit 1; fi
+done
+echo "resumed run has the same outputs as $ref_dir"